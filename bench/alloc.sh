@@ -0,0 +1,30 @@
+#!/usr/bin/env bash
+# heap blocks allocated per `+`: numbers are immediates, so none
+. bench/common.bash
+
+n=1000000
+cat > "$TMP/alloc.slip" <<SLIP
+def {sum} (\\ {n acc} {if (== n 0) {acc} {sum (- n 1) (+ acc n)}})
+def {loop} (\\ {n acc} {if (== n 0) {acc} {loop (- n 1) acc}})
+mem-stats ()
+sum $n 0
+mem-stats ()
+loop $n 0
+mem-stats ()
+SLIP
+
+set -- $(bench_allocs "$TMP/alloc.slip")
+echo "alloc: $n iterations"
+printf '  %-24s %d blocks per iteration\n' "loop with +" $(( ($2 - $1) / n ))
+printf '  %-24s %d blocks per iteration\n' "loop without +" $(( ($3 - $2) / n ))
+printf '  %-24s %d blocks\n' "per +" $(( ($2 - $1 - ($3 - $2)) / n ))
+
+for size in 1000 10000 100000; do
+  {
+    echo 'mem-stats ()'
+    echo "+ $(seq -s ' ' $size)"
+    echo 'mem-stats ()'
+  } > "$TMP/plus.slip"
+  set -- $(bench_allocs "$TMP/plus.slip")
+  printf '  %-24s %d blocks\n' "+ over $size literals" $(( $2 - $1 ))
+done
@@ -0,0 +1,18 @@
+# sourced by every benchmark. run them from the top of the tree,
+# `make bench` runs them all. SLIP picks another binary to measure.
+SLIP=${SLIP:-./slip}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+TIMEFORMAT=%3R
+
+# milliseconds slip takes to run a file in batch mode
+bench_time(){
+  local t
+  t=$( { time "$SLIP" --batch < "$1" > /dev/null; } 2>&1 )
+  echo $(( 10#${t/./} ))
+}
+
+# the allocs field of every mem-stats line slip prints for a file
+bench_allocs(){
+  "$SLIP" --batch < "$1" | sed -n 's/^{slabs.* allocs \([0-9]*\)}$/\1/p'
+}
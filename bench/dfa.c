@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lib/mpc.h"
+
+// tokenises the same input with slip's number and symbol regexes twice:
+// as they are, which mpc_re compiles to a DFA, and wrapped in a group,
+// which keeps them on the combinator tree
+
+// the tokens themselves are not kept
+static mpc_val_t* bench_drop(int n, mpc_val_t** xs){
+  for(int i = 0; i < n; i++){ free(xs[i]); }
+  return NULL;
+}
+
+static double bench_run(const char* number, const char* symbol, const char* input){
+  mpc_parser_t* tokens = mpc_many(bench_drop,
+    mpc_tok(mpc_or(2, mpc_re(number), mpc_re(symbol))));
+  mpc_parser_t* all = mpc_and(2, mpcf_snd_free, tokens, mpc_eoi(), free);
+
+  clock_t start = clock();
+  mpc_result_t r;
+  if(!mpc_parse("<bench>", input, all, &r)){
+    mpc_err_print(r.error);
+    mpc_err_delete(r.error);
+    exit(1);
+  }
+  double ms = (double)(clock() - start) * 1000 / CLOCKS_PER_SEC;
+
+  free(r.output);
+  mpc_delete(all);
+  return ms;
+}
+
+int main(int argc, char** argv){
+  long size = argc > 1 ? atol(argv[1]) : 4 * 1024 * 1024;
+  const char* words[] = {"42", "-17", "fib-acc", "x_1", "+", "==", "1000000", "\\"};
+
+  char* input = malloc(size + 32);
+  long len = 0;
+  for(int i = 0; len < size; i++){
+    len += sprintf(input + len, "%s ", words[i % 8]);
+  }
+
+  double dfa = bench_run("-?[0-9]+", "[a-zA-Z0-9_+\\-*\\/\\\\=<>!&]+", input);
+  double tree = bench_run("(-?[0-9]+)", "([a-zA-Z0-9_+\\-*\\/\\\\=<>!&]+)", input);
+  printf("dfa: tokenising %ld bytes\n", len);
+  printf("  %-24s %6.0f ms\n", "dfa", dfa);
+  printf("  %-24s %6.0f ms  %.1fx\n", "combinator tree", tree, tree / dfa);
+
+  free(input);
+  return 0;
+}
@@ -0,0 +1,7 @@
+#!/usr/bin/env bash
+# tokenising with regexes compiled to a DFA against the combinator tree,
+# bench/dfa.c is built against lib/mpc.c for it
+. bench/common.bash
+
+${CC:-cc} -std=c99 -O2 -I. -o "$TMP/dfa" bench/dfa.c lib/mpc.c || exit 1
+"$TMP/dfa" $(( 4 * 1024 * 1024 ))
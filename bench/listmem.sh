@@ -0,0 +1,31 @@
+#!/usr/bin/env bash
+# bytes per live value when building lists. cell vectors are malloc'd
+# outside the slabs and cost 8 bytes a slot on top of what is shown
+. bench/common.bash
+
+# the used and bytes fields of every mem-stats line
+mem_fields(){
+  "$SLIP" --batch < "$1" | sed -n 's/^{slabs [0-9]* used \([0-9]*\) .* bytes \([0-9]*\) .*}$/\1 \2/p'
+}
+
+n=100000
+cat > "$TMP/listmem.slip" <<SLIP
+def {nums} (\\ {n acc} {if (== n 0) {acc} {nums (- n 1) (cons n acc)}})
+def {pairs} (\\ {n acc} {if (== n 0) {acc} {pairs (- n 1) (cons (list n n) acc)}})
+def {nested} (\\ {n acc} {if (== n 0) {acc} {nested (- n 1) (cons (list (list n) {}) acc)}})
+mem-stats ()
+def {a} (nums $n {})
+mem-stats ()
+def {b} (pairs $n {})
+mem-stats ()
+def {c} (nested $n {})
+mem-stats ()
+SLIP
+
+set -- $(mem_fields "$TMP/listmem.slip")
+echo "listmem: $n elements"
+for name in "numbers" "pairs {n n}" "nested {{n} {}}"; do
+  printf '  %-24s %d values, %d slab bytes per element\n' "$name" \
+    $(( ($3 - $1) / n )) $(( ($4 - $2 + n / 2) / n ))
+  shift 2
+done
@@ -0,0 +1,16 @@
+#!/usr/bin/env bash
+# global lookups with 10 to 100k bindings in the global scope, the time
+# for a million lookups should not grow with the scope
+. bench/common.bash
+
+n=1000000
+echo "lookup: $n lookups of the last global defined"
+for size in 10 100 1000 10000 100000; do
+  for i in $(seq $size); do echo "def {g$i} 1"; done > "$TMP/defs.slip"
+  echo "def {loop} (\\ {n} {if (== n 0) {0} {loop (- n g$size)}})" >> "$TMP/defs.slip"
+  { cat "$TMP/defs.slip"; echo "loop $n"; } > "$TMP/lookup.slip"
+
+  base=$(bench_time "$TMP/defs.slip")
+  total=$(bench_time "$TMP/lookup.slip")
+  printf '  %-24s %d ms\n' "$size globals" $(( total - base ))
+done
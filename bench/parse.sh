@@ -0,0 +1,22 @@
+#!/usr/bin/env bash
+# mpc parsing one line of 1 KB to 10 MB, the time per byte should stay
+# flat now that string inputs know their length
+. bench/common.bash
+
+mpc_time(){
+  local t
+  t=$( { time "$SLIP" --batch --mpc < "$1" > /dev/null; } 2>&1 )
+  echo $(( 10#${t/./} ))
+}
+
+: > "$TMP/empty.slip"
+base=$(mpc_time "$TMP/empty.slip")
+
+echo "parse: one quoted list through --mpc, startup taken off"
+for size in 1000 10000 100000 1000000 10000000; do
+  # "12 " is three bytes
+  { printf '{'; yes 12 | head -n $(( size / 3 )) | tr '\n' ' '; printf '}\n'; } > "$TMP/parse.slip"
+  t=$(( $(mpc_time "$TMP/parse.slip") - base ))
+  printf '  %-24s %6d ms  %4d ns per byte\n' "$size bytes" $t \
+    $(( t * 1000000 / size ))
+done
@@ -0,0 +1,12 @@
+#!/usr/bin/env bash
+# variadic + over 100k literals, time per operand should stay flat
+. bench/common.bash
+
+echo "plus: + over n literals, 20 times"
+for size in 12500 25000 50000 100000 200000; do
+  line="+ $(seq -s ' ' $size)"
+  for i in $(seq 20); do echo "$line"; done > "$TMP/plus.slip"
+  t=$(bench_time "$TMP/plus.slip")
+  printf '  %-24s %6d ms  %4d ns per operand\n' "$size literals" $t \
+    $(( t * 1000000 / (20 * size) ))
+done
@@ -0,0 +1,21 @@
+#!/usr/bin/env bash
+# reading multi-megabyte input with the reader and with the old mpc
+# grammar. lines are quoted lists, they evaluate to themselves
+. bench/common.bash
+
+line='{def {fib-acc} (\ {a b n} {if (== n 0) {a} {fib-acc (+ a b) a (- n 1)}}) -42 True x_1}'
+
+mpc_time(){
+  local t
+  t=$( { time "$SLIP" --batch --mpc < "$1" > /dev/null; } 2>&1 )
+  echo $(( 10#${t/./} ))
+}
+
+echo "reader: lines of ${#line} bytes"
+for mb in 1 4 16; do
+  n=$(( mb * 1024 * 1024 / (${#line} + 1) ))
+  for i in $(seq $n); do echo "$line"; done > "$TMP/reader.slip"
+  t=$(bench_time "$TMP/reader.slip")
+  m=$(mpc_time "$TMP/reader.slip")
+  printf '  %-24s %6d ms  mpc %6d ms\n' "$mb MB" $t $m
+done
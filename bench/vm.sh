@@ -0,0 +1,33 @@
+#!/usr/bin/env bash
+# bytecode vm workloads. BASE=old/slip runs them on another build too,
+# e.g. one from before the vm, and prints how much faster SLIP is
+. bench/common.bash
+
+fib='def {fib} (\ {n} {if (== n 0) {0} {if (== n 1) {1} {+ (fib (- n 1)) (fib (- n 2))}}})'
+loop='def {loop} (\ {n} {if (== n 0) {0} {loop (- n 1)}})'
+range='def {range} (\ {n acc} {if (== n 0) {acc} {range (- n 1) (join (list n) acc)}})'
+sum='def {sum} (\ {l acc} {if (== l {}) {acc} {sum (tail l) (+ acc (eval (head l)))}})'
+
+repeat(){
+  for i in $(seq $1); do echo "$2"; done
+}
+
+workload(){
+  local name=$1; shift
+  printf '%s\n' "$@" > "$TMP/vm.slip"
+  local t=$(bench_time "$TMP/vm.slip")
+  if [ -n "$BASE" ]; then
+    local b=$(SLIP=$BASE bench_time "$TMP/vm.slip")
+    printf '  %-24s %6d ms  base %6d ms  %d.%02dx\n' "$name" $t $b \
+      $(( b / (t > 0 ? t : 1) )) $(( b * 100 / (t > 0 ? t : 1) % 100 ))
+  else
+    printf '  %-24s %6d ms\n' "$name" $t
+  fi
+}
+
+echo "vm: lambda-heavy workloads"
+workload "fib 24" "$fib" "fib 24"
+workload "loop 50000, 20 times" "$loop" "$(repeat 20 "loop 50000")"
+workload "range 1000, 10 times" "$range" "$(repeat 10 "range 1000 {}")"
+workload "sum over 2000, 20 times" "$range" "$sum" "def {xs} (range 2000 {})" \
+  "$(repeat 20 "sum xs 0")"
@@ -33,21 +33,18 @@ static mpc_state_t mpc_state_new(void) {
 ** The cursor can jump around at will making 
 ** backtracking easy.
 **
-** The second is a File which is also somewhat
-** easy. The contents are never loaded into 
-** memory but backtracking can still be achieved
-** by seeking in the file at different positions.
+** File and Pipe are both read in blocks into
+** a buffer. Reading a character is then just a
+** bounds check and a load, like for a String.
+** The buffer keeps everything from the oldest
+** mark onwards, so backtracking never has to
+** seek. Once no mark can go back to the start
+** of the buffer that part is dropped, so memory
+** is bounded by how far the parser can rewind.
 **
-** The final mode is Pipe. This is the difficult
-** one. As we assume pipes cannot be seeked - and 
-** only support a single character lookahead at 
-** any point, when the input is marked for a 
-** potential backtracking we start buffering any 
-** input.
-**
-** This means that if we are requested to seek
-** back we can simply start reading from the
-** buffer instead of the input.
+** A File is read a whole block at a time. A
+** Pipe may be interactive so it is only read up
+** to the end of the current line.
 **
 ** Of course using `mpc_predictive` will disable
 ** backtracking and make LL(1) grammars easy
@@ -65,6 +62,10 @@ enum {
   MPC_INPUT_MARKS_MIN = 32
 };
 
+enum {
+  MPC_INPUT_BLOCK = 64 * 1024
+};
+
 enum {
   MPC_INPUT_MEM_NUM = 512
 };
@@ -73,6 +74,29 @@ typedef struct {
   char mem[64];
 } mpc_mem_t;
 
+/*
+** Packrat memo slots are keyed by parser and
+** position. The table has a fixed number of them
+** so memory stays bounded, a colliding result
+** just replaces the older one.
+*/
+
+enum {
+  MPC_INPUT_MEMO_NUM = 4096
+};
+
+typedef struct {
+  mpc_parser_t *parser;
+  long pos;
+  int suppress;
+  int success;
+  mpc_state_t state;
+  char last;
+  mpc_ast_t *output;
+  mpc_err_t *error;
+  mpc_err_t *merged;
+} mpc_memo_t;
+
 typedef struct {
 
   int type;
@@ -80,8 +104,16 @@ typedef struct {
   mpc_state_t state;
   
   char *string;
+  size_t length;
+  
   char *buffer;
+  long buffer_pos;
+  size_t buffer_len;
+  size_t buffer_size;
+  int buffer_eof;
+  int buffer_keep;
   FILE *file;
+  long origin;
   
   int suppress;
   int backtrack;
@@ -96,6 +128,8 @@ typedef struct {
   char mem_full[MPC_INPUT_MEM_NUM];
   mpc_mem_t mem[MPC_INPUT_MEM_NUM];
   
+  mpc_memo_t *memo;
+  
 } mpc_input_t;
 
 static mpc_input_t *mpc_input_new_string(const char *filename, const char *string) {
@@ -108,10 +142,17 @@ static mpc_input_t *mpc_input_new_string(const char *filename, const char *strin
   
   i->state = mpc_state_new();
   
-  i->string = malloc(strlen(string) + 1);
-  strcpy(i->string, string);
+  i->length = strlen(string);
+  i->string = malloc(i->length + 1);
+  memcpy(i->string, string, i->length + 1);
   i->buffer = NULL;
+  i->buffer_pos = 0;
+  i->buffer_len = 0;
+  i->buffer_size = 0;
+  i->buffer_eof = 0;
+  i->buffer_keep = 0;
   i->file = NULL;
+  i->origin = 0;
   
   i->suppress = 0;
   i->backtrack = 1;
@@ -124,6 +165,8 @@ static mpc_input_t *mpc_input_new_string(const char *filename, const char *strin
   i->mem_index = 0;
   memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
   
+  i->memo = NULL;
+  
   return i;
 }
 
@@ -140,8 +183,16 @@ static mpc_input_t *mpc_input_new_nstring(const char *filename, const char *stri
   i->string = malloc(length + 1);
   strncpy(i->string, string, length);
   i->string[length] = '\0';
+  /* input still ends at the first NUL, as it did before the length was kept */
+  i->length = strlen(i->string);
   i->buffer = NULL;
+  i->buffer_pos = 0;
+  i->buffer_len = 0;
+  i->buffer_size = 0;
+  i->buffer_eof = 0;
+  i->buffer_keep = 0;
   i->file = NULL;
+  i->origin = 0;
   
   i->suppress = 0;
   i->backtrack = 1;
@@ -154,6 +205,8 @@ static mpc_input_t *mpc_input_new_nstring(const char *filename, const char *stri
   i->mem_index = 0;
   memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
   
+  i->memo = NULL;
+  
   return i;
 
 }
@@ -169,8 +222,15 @@ static mpc_input_t *mpc_input_new_pipe(const char *filename, FILE *pipe) {
   i->state = mpc_state_new();
   
   i->string = NULL;
+  i->length = 0;
   i->buffer = NULL;
+  i->buffer_pos = 0;
+  i->buffer_len = 0;
+  i->buffer_size = 0;
+  i->buffer_eof = 0;
+  i->buffer_keep = 0;
   i->file = pipe;
+  i->origin = -1;
   
   i->suppress = 0;
   i->backtrack = 1;
@@ -183,6 +243,8 @@ static mpc_input_t *mpc_input_new_pipe(const char *filename, FILE *pipe) {
   i->mem_index = 0;
   memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
   
+  i->memo = NULL;
+  
   return i;
   
 }
@@ -197,8 +259,15 @@ static mpc_input_t *mpc_input_new_file(const char *filename, FILE *file) {
   i->state = mpc_state_new();
   
   i->string = NULL;
+  i->length = 0;
   i->buffer = NULL;
+  i->buffer_pos = 0;
+  i->buffer_len = 0;
+  i->buffer_size = 0;
+  i->buffer_eof = 0;
+  i->buffer_keep = 0;
   i->file = file;
+  i->origin = ftell(file);
   
   i->suppress = 0;
   i->backtrack = 1;
@@ -211,15 +280,34 @@ static mpc_input_t *mpc_input_new_file(const char *filename, FILE *file) {
   i->mem_index = 0;
   memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
   
+  i->memo = NULL;
+  
   return i;
 }
 
+static void mpc_input_memo_clear(mpc_input_t *i) {
+  
+  int j;
+  
+  if (i->memo == NULL) { return; }
+  
+  for (j = 0; j < MPC_INPUT_MEMO_NUM; j++) {
+    mpc_ast_delete(i->memo[j].output);
+    if (i->memo[j].error) { mpc_err_delete(i->memo[j].error); }
+    if (i->memo[j].merged) { mpc_err_delete(i->memo[j].merged); }
+  }
+  free(i->memo);
+  i->memo = NULL;
+}
+
 static void mpc_input_delete(mpc_input_t *i) {
   
   free(i->filename);
   
+  mpc_input_memo_clear(i);
+  
   if (i->type == MPC_INPUT_STRING) { free(i->string); }
-  if (i->type == MPC_INPUT_PIPE) { free(i->buffer); }
+  free(i->buffer);
   
   free(i->marks);
   free(i->lasts);
@@ -311,10 +399,6 @@ static void mpc_input_mark(mpc_input_t *i) {
   i->marks[i->marks_num-1] = i->state;
   i->lasts[i->marks_num-1] = i->last;
   
-  if (i->type == MPC_INPUT_PIPE && i->marks_num == 1) {
-    i->buffer = calloc(1, 1);
-  }
-  
 }
 
 static void mpc_input_unmark(mpc_input_t *i) {
@@ -332,11 +416,20 @@ static void mpc_input_unmark(mpc_input_t *i) {
     i->lasts = realloc(i->lasts, sizeof(char) * i->marks_slots);      
   }
   
-  if (i->type == MPC_INPUT_PIPE && i->marks_num == 0) {
-    free(i->buffer);
-    i->buffer = NULL;
+}
+
+/* Back to the start of the input, only called between parses */
+static void mpc_input_reset(mpc_input_t *i) {
+  i->state = mpc_state_new();
+  i->last = '\0';
+  i->marks_num = 0;
+  if (i->type == MPC_INPUT_FILE && i->origin >= 0) {
+    fseek(i->file, i->origin, SEEK_SET);
+    i->buffer_pos = 0;
+    i->buffer_len = 0;
+    i->buffer_eof = 0;
   }
-  
+  i->buffer_keep = 0;
 }
 
 static void mpc_input_rewind(mpc_input_t *i) {
@@ -346,118 +439,88 @@ static void mpc_input_rewind(mpc_input_t *i) {
   i->state = i->marks[i->marks_num-1];
   i->last  = i->lasts[i->marks_num-1];
   
-  if (i->type == MPC_INPUT_FILE) {
-    fseek(i->file, i->state.pos, SEEK_SET);
-  }
-  
   mpc_input_unmark(i);
 }
 
-static int mpc_input_buffer_in_range(mpc_input_t *i) {
-  return i->state.pos < (long)(strlen(i->buffer) + i->marks[0].pos);
-}
-
-static char mpc_input_buffer_get(mpc_input_t *i) {
-  return i->buffer[i->state.pos - i->marks[0].pos];
-}
-
-static int mpc_input_terminated(mpc_input_t *i) {
-  if (i->type == MPC_INPUT_STRING && i->state.pos == (long)strlen(i->string)) { return 1; }
-  if (i->type == MPC_INPUT_FILE && feof(i->file)) { return 1; }
-  if (i->type == MPC_INPUT_PIPE && feof(i->file)) { return 1; }
-  return 0;
-}
-
-static char mpc_input_getc(mpc_input_t *i) {
+static size_t mpc_input_read(mpc_input_t *i, char *b, size_t n) {
   
-  char c = '\0';
+  size_t k = 0;
+  int c;
   
-  switch (i->type) {
-    
-    case MPC_INPUT_STRING: return i->string[i->state.pos];
-    case MPC_INPUT_FILE: c = fgetc(i->file); return c;
-    case MPC_INPUT_PIPE:
-    
-      if (!i->buffer) { c = getc(i->file); return c; }
-      
-      if (i->buffer && mpc_input_buffer_in_range(i)) {
-        c = mpc_input_buffer_get(i);
-        return c;
-      } else {
-        c = getc(i->file);
-        return c;
-      }
-    
-    default: return c;
+  if (i->type == MPC_INPUT_FILE) { return fread(b, 1, n, i->file); }
+  
+  while (k < n && (c = getc(i->file)) != EOF) {
+    b[k++] = (char)c;
+    if (c == '\n') { break; }
   }
+  return k;
 }
 
-static char mpc_input_peekc(mpc_input_t *i) {
+/* Reads until the byte at pos is in the buffer, 0 if the input ends first */
+static int mpc_input_buffer_fill(mpc_input_t *i, long pos) {
   
-  char c = '\0';
+  long keep, drop;
+  size_t n;
   
-  switch (i->type) {
-    case MPC_INPUT_STRING: return i->string[i->state.pos];
-    case MPC_INPUT_FILE: 
-      
-      c = fgetc(i->file);
-      if (feof(i->file)) { return '\0'; }
-      
-      fseek(i->file, -1, SEEK_CUR);
-      return c;
+  while (pos >= i->buffer_pos + (long)i->buffer_len) {
     
-    case MPC_INPUT_PIPE:
-      
-      if (!i->buffer) {
-        c = getc(i->file);
-        if (feof(i->file)) { return '\0'; }
-        ungetc(c, i->file);
-        return c;
-      }
-      
-      if (i->buffer && mpc_input_buffer_in_range(i)) {
-        return mpc_input_buffer_get(i);
-      } else {
-        c = getc(i->file);
-        if (feof(i->file)) { return '\0'; }
-        ungetc(c, i->file);
-        return c;
-      }
+    if (i->buffer_eof) { return 0; }
+    
+    /* Only drop once it is at least half the buffer, so moving stays linear */
+    keep = i->state.pos;
+    if (i->marks_num > 0 && i->marks[0].pos < keep) { keep = i->marks[0].pos; }
+    if (i->buffer_keep) { keep = i->buffer_pos; }
+    drop = keep - i->buffer_pos;
+    if (drop > 0 && (size_t)drop >= i->buffer_len / 2) {
+      memmove(i->buffer, i->buffer + drop, i->buffer_len - drop);
+      i->buffer_len -= drop;
+      i->buffer_pos = keep;
+    }
+    
+    if (i->buffer_len + MPC_INPUT_BLOCK > i->buffer_size) {
+      i->buffer_size = i->buffer_size ? i->buffer_size * 2 : MPC_INPUT_BLOCK;
+      while (i->buffer_len + MPC_INPUT_BLOCK > i->buffer_size) { i->buffer_size *= 2; }
+      i->buffer = realloc(i->buffer, i->buffer_size);
+    }
     
-    default: return c;
+    n = mpc_input_read(i, i->buffer + i->buffer_len, MPC_INPUT_BLOCK);
+    if (n == 0) { i->buffer_eof = 1; return 0; }
+    i->buffer_len += n;
   }
   
+  return 1;
 }
 
-static int mpc_input_failure(mpc_input_t *i, char c) {
-
-  switch (i->type) {
-    case MPC_INPUT_STRING: { break; }
-    case MPC_INPUT_FILE: fseek(i->file, -1, SEEK_CUR); { break; }
-    case MPC_INPUT_PIPE: {
-      
-      if (!i->buffer) { ungetc(c, i->file); break; }
-      
-      if (i->buffer && mpc_input_buffer_in_range(i)) {
-        break;
-      } else {
-        ungetc(c, i->file); 
-      }
-    }
-    default: { break; }
+/* The byte at pos, or -1 past the end of the input */
+static int mpc_input_at(mpc_input_t *i, long pos) {
+  if (i->type == MPC_INPUT_STRING) {
+    return (size_t)pos < i->length ? (unsigned char)i->string[pos] : -1;
   }
+  if (pos >= i->buffer_pos + (long)i->buffer_len
+  &&  !mpc_input_buffer_fill(i, pos)) { return -1; }
+  return (unsigned char)i->buffer[pos - i->buffer_pos];
+}
+
+static int mpc_input_terminated(mpc_input_t *i) {
+  return mpc_input_at(i, i->state.pos) < 0;
+}
+
+static char mpc_input_getc(mpc_input_t *i) {
+  int c = mpc_input_at(i, i->state.pos);
+  return c < 0 ? '\0' : (char)c;
+}
+
+static char mpc_input_peekc(mpc_input_t *i) {
+  return mpc_input_getc(i);
+}
+
+static int mpc_input_failure(mpc_input_t *i, char c) {
+  (void)i; (void)c;
   return 0;
 }
 
 static int mpc_input_success(mpc_input_t *i, char c, char **o) {
   
-  if (i->type == MPC_INPUT_PIPE
-  &&  i->buffer && !mpc_input_buffer_in_range(i)) {
-    i->buffer = realloc(i->buffer, strlen(i->buffer) + 2);
-    i->buffer[strlen(i->buffer) + 1] = '\0';
-    i->buffer[strlen(i->buffer) + 0] = c;
-  }
-  
   i->last = c;
   i->state.pos++;
   i->state.col++;
@@ -536,6 +599,87 @@ static int mpc_input_anchor(mpc_input_t* i, int(*f)(char,char), char **o) {
   return f(i->last, mpc_input_peekc(i));
 }
 
+/*
+** A regex compiled by `mpc_re` to a DFA is one
+** table per alternative, tried in order. Each
+** entry is the next state for a character, or
+** says the match stops before it or fails.
+*/
+
+enum {
+  MPC_DFA_STOP = -1,
+  MPC_DFA_FAIL = -2
+};
+
+typedef struct {
+  int soi;
+  int states;
+  int *table;
+  char *accept;
+} mpc_dfa_branch_t;
+
+typedef struct {
+  int n;
+  mpc_dfa_branch_t *branches;
+} mpc_dfa_t;
+
+static int mpc_input_dfa(mpc_input_t *i, mpc_dfa_t *d, char **o) {
+  
+  const char *str = i->string;
+  long start = i->state.pos, base = 0, end = (long)i->length, p, q;
+  mpc_dfa_branch_t *b;
+  int j, s, t;
+  
+  if (i->type != MPC_INPUT_STRING) {
+    str = i->buffer;
+    base = i->buffer_pos;
+    end = base + (long)i->buffer_len;
+  }
+  
+  for (j = 0; j < d->n; j++) {
+    
+    b = &d->branches[j];
+    if (b->soi && i->last != '\0') { continue; }
+    
+    s = 0;
+    p = start;
+    for (;;) {
+      /* Only a buffer can read more, and it may move when it does */
+      if (p >= end && i->type != MPC_INPUT_STRING && mpc_input_at(i, p) >= 0) {
+        str = i->buffer;
+        base = i->buffer_pos;
+        end = base + (long)i->buffer_len;
+      }
+      if (p >= end) { t = b->accept[s] ? MPC_DFA_STOP : MPC_DFA_FAIL; break; }
+      t = b->table[s * 256 + (unsigned char)str[p - base]];
+      if (t < 0) { break; }
+      s = t;
+      p++;
+    }
+    if (t == MPC_DFA_FAIL) { continue; }
+    
+    /* Nothing from start on is dropped, the position has not moved */
+    str += start - base;
+    p -= start;
+    
+    for (q = 0; q < p; q++) {
+      if (str[q] == '\n') { i->state.col = 0; i->state.row++; }
+      else { i->state.col++; }
+    }
+    i->state.pos = start + p;
+    
+    *o = mpc_malloc(i, p + 1);
+    if (p > 0) {
+      i->last = str[p-1];
+      memcpy(*o, str, p);
+    }
+    (*o)[p] = '\0';
+    return 1;
+  }
+  
+  return 0;
+}
+
 static mpc_state_t *mpc_input_state_copy(mpc_input_t *i) {
   mpc_state_t *r = mpc_malloc(i, sizeof(mpc_state_t));
   memcpy(r, &i->state, sizeof(mpc_state_t));
@@ -546,6 +690,12 @@ static mpc_state_t *mpc_input_state_copy(mpc_input_t *i) {
 ** Error Type
 */
 
+static mpc_parse_stats_t mpc_parse_totals;
+
+void mpc_parse_stats(mpc_parse_stats_t *s) {
+  *s = mpc_parse_totals;
+}
+
 void mpc_err_delete(mpc_err_t *x) {
   int i;
   for (i = 0; i < x->expected_num; i++) { free(x->expected[i]); }
@@ -641,6 +791,7 @@ static mpc_err_t *mpc_err_new(mpc_input_t *i, const char *expected) {
   mpc_err_t *x;
   if (i->suppress) { return NULL; }
   x = mpc_malloc(i, sizeof(mpc_err_t));
+  mpc_parse_totals.errors++;
   x->filename = mpc_malloc(i, strlen(i->filename) + 1);
   strcpy(x->filename, i->filename);
   x->state = i->state;
@@ -657,6 +808,7 @@ static mpc_err_t *mpc_err_fail(mpc_input_t *i, const char *failure) {
   mpc_err_t *x;
   if (i->suppress) { return NULL; }
   x = mpc_malloc(i, sizeof(mpc_err_t));
+  mpc_parse_totals.errors++;
   x->filename = mpc_malloc(i, strlen(i->filename) + 1);
   strcpy(x->filename, i->filename);
   x->state = i->state;
@@ -703,6 +855,33 @@ static mpc_err_t *mpc_err_export(mpc_input_t *i, mpc_err_t *x) {
   return mpc_export(i, x);
 }
 
+static mpc_err_t *mpc_err_copy(mpc_input_t *i, mpc_err_t *x) {
+  int j;
+  mpc_err_t *y;
+  if (x == NULL) { return NULL; }
+  y = mpc_malloc(i, sizeof(mpc_err_t));
+  mpc_parse_totals.errors++;
+  y->state = x->state;
+  y->recieved = x->recieved;
+  y->filename = mpc_malloc(i, strlen(x->filename) + 1);
+  strcpy(y->filename, x->filename);
+  y->failure = NULL;
+  if (x->failure) {
+    y->failure = mpc_malloc(i, strlen(x->failure) + 1);
+    strcpy(y->failure, x->failure);
+  }
+  y->expected_num = x->expected_num;
+  y->expected = NULL;
+  if (x->expected_num) {
+    y->expected = mpc_malloc(i, sizeof(char*) * x->expected_num);
+    for (j = 0; j < x->expected_num; j++) {
+      y->expected[j] = mpc_malloc(i, strlen(x->expected[j]) + 1);
+      strcpy(y->expected[j], x->expected[j]);
+    }
+  }
+  return y;
+}
+
 static int mpc_err_contains_expected(mpc_input_t *i, mpc_err_t *x, char *expected) {
   int j;
   (void)i;
@@ -733,6 +912,7 @@ static mpc_err_t *mpc_err_or(mpc_input_t *i, mpc_err_t** x, int n) {
   if (fst == -1) { return NULL; }
   
   e = mpc_malloc(i, sizeof(mpc_err_t));
+  mpc_parse_totals.errors++;
   e->state = mpc_state_invalid();
   e->expected_num = 0;
   e->expected = NULL;
@@ -882,7 +1062,10 @@ enum {
   MPC_TYPE_COUNT     = 22,
   
   MPC_TYPE_OR        = 23,
-  MPC_TYPE_AND       = 24
+  MPC_TYPE_AND       = 24,
+  
+  MPC_TYPE_MEMO      = 25,
+  MPC_TYPE_DFA       = 26
 };
 
 typedef struct { char *m; } mpc_pdata_fail_t;
@@ -896,6 +1079,8 @@ typedef struct { char *x; } mpc_pdata_string_t;
 typedef struct { mpc_parser_t *x; mpc_apply_t f; } mpc_pdata_apply_t;
 typedef struct { mpc_parser_t *x; mpc_apply_to_t f; void *d; } mpc_pdata_apply_to_t;
 typedef struct { mpc_parser_t *x; } mpc_pdata_predict_t;
+typedef struct { mpc_parser_t *x; } mpc_pdata_memo_t;
+typedef struct { mpc_parser_t *x; mpc_dfa_t *dfa; } mpc_pdata_dfa_t;
 typedef struct { mpc_parser_t *x; mpc_dtor_t dx; mpc_ctor_t lf; } mpc_pdata_not_t;
 typedef struct { int n; mpc_fold_t f; mpc_parser_t *x; mpc_dtor_t dx; } mpc_pdata_repeat_t;
 typedef struct { int n; mpc_parser_t **xs; } mpc_pdata_or_t;
@@ -913,6 +1098,8 @@ typedef union {
   mpc_pdata_apply_t apply;
   mpc_pdata_apply_to_t apply_to;
   mpc_pdata_predict_t predict;
+  mpc_pdata_memo_t memo;
+  mpc_pdata_dfa_t dfa;
   mpc_pdata_not_t not;
   mpc_pdata_repeat_t repeat;
   mpc_pdata_and_t and;
@@ -924,6 +1111,7 @@ struct mpc_parser_t {
   mpc_pdata_t data;
   char type;
   char retained;
+  char arena;
 };
 
 static mpc_val_t *mpcf_input_nth_free(mpc_input_t *i, int n, mpc_val_t **xs, int x) {
@@ -996,6 +1184,204 @@ static void mpc_parse_dtor(mpc_input_t *i, mpc_dtor_t d, mpc_val_t *x) {
   d(mpc_export(i, x));
 }
 
+/*
+** AST Arena
+**
+** Every AST node carries a small hidden header in
+** front of it. For nodes built while parsing with
+** an arena parser it points at the arena, which
+** holds the nodes, their children arrays and their
+** strings for that one parse. Tags are interned in
+** the arena, so nodes share them.
+**
+** Deleting the root of the result frees the whole
+** arena at once. Deleting any other arena node does
+** nothing, its memory lives as long as the root.
+*/
+
+enum {
+  MPC_ARENA_ALIGN     = 16,
+  MPC_ARENA_BLOCK_MIN = 64 * 1024,
+  MPC_ARENA_BLOCK_MAX = 4 * 1024 * 1024
+};
+
+#define MPC_ARENA_ROUND(n) (((n) + MPC_ARENA_ALIGN - 1) & ~(size_t)(MPC_ARENA_ALIGN - 1))
+
+typedef struct mpc_arena_block_t {
+  struct mpc_arena_block_t *next;
+  size_t size;
+  size_t used;
+} mpc_arena_block_t;
+
+typedef struct {
+  mpc_arena_block_t *blocks;
+  mpc_ast_t *root;
+  char **tags;
+  size_t tags_slots;
+  size_t tags_num;
+} mpc_arena_t;
+
+typedef struct {
+  mpc_arena_t *arena;
+  int children_slots;
+} mpc_ast_head_t;
+
+/* Arena for ASTs built by the parse that is running */
+static mpc_arena_t *mpc_arena_current = NULL;
+
+static mpc_ast_head_t *mpc_ast_head(mpc_ast_t *a) {
+  return ((mpc_ast_head_t*)a) - 1;
+}
+
+static mpc_arena_t *mpc_arena_new(void) {
+  return calloc(1, sizeof(mpc_arena_t));
+}
+
+static void mpc_arena_delete(mpc_arena_t *a) {
+  mpc_arena_block_t *b = a->blocks, *n;
+  while (b) { n = b->next; free(b); b = n; }
+  free(a->tags);
+  free(a);
+}
+
+static void *mpc_arena_alloc(mpc_arena_t *a, size_t n) {
+  
+  mpc_arena_block_t *b = a->blocks;
+  size_t size;
+  char *p;
+  
+  n = MPC_ARENA_ROUND(n);
+  
+  if (b == NULL || b->used + n > b->size) {
+    size = b ? b->size * 2 : MPC_ARENA_BLOCK_MIN;
+    if (size > MPC_ARENA_BLOCK_MAX) { size = MPC_ARENA_BLOCK_MAX; }
+    if (size < n) { size = n; }
+    b = malloc(MPC_ARENA_ROUND(sizeof(mpc_arena_block_t)) + size);
+    b->next = a->blocks;
+    b->size = size;
+    b->used = 0;
+    a->blocks = b;
+  }
+  
+  p = (char*)b + MPC_ARENA_ROUND(sizeof(mpc_arena_block_t)) + b->used;
+  b->used += n;
+  return p;
+}
+
+static char *mpc_arena_strndup(mpc_arena_t *a, const char *s, size_t n) {
+  char *p = mpc_arena_alloc(a, n + 1);
+  memcpy(p, s, n);
+  p[n] = '\0';
+  return p;
+}
+
+static size_t mpc_arena_hash(const char *s, size_t n) {
+  size_t j, h = 5381;
+  for (j = 0; j < n; j++) { h = h * 33 + (unsigned char)s[j]; }
+  return h;
+}
+
+static char *mpc_arena_intern(mpc_arena_t *a, const char *s, size_t n) {
+  
+  size_t j, h, slots;
+  char **tags;
+  char *t;
+  
+  if (a->tags_num * 2 >= a->tags_slots) {
+    slots = a->tags_slots ? a->tags_slots * 2 : 64;
+    tags = calloc(slots, sizeof(char*));
+    for (j = 0; j < a->tags_slots; j++) {
+      if (a->tags[j] == NULL) { continue; }
+      h = mpc_arena_hash(a->tags[j], strlen(a->tags[j])) & (slots - 1);
+      while (tags[h]) { h = (h + 1) & (slots - 1); }
+      tags[h] = a->tags[j];
+    }
+    free(a->tags);
+    a->tags = tags;
+    a->tags_slots = slots;
+  }
+  
+  h = mpc_arena_hash(s, n) & (a->tags_slots - 1);
+  while ((t = a->tags[h])) {
+    if (strncmp(t, s, n) == 0 && t[n] == '\0') { return t; }
+    h = (h + 1) & (a->tags_slots - 1);
+  }
+  
+  t = mpc_arena_strndup(a, s, n);
+  a->tags[h] = t;
+  a->tags_num++;
+  return t;
+}
+
+/*
+** Packrat Memo
+**
+** Only string inputs are memoised, they are the
+** only ones that can jump straight to a later
+** position. A hit on a success hands out a copy
+** of the stored AST and replays the errors that
+** were merged while it was first parsed, so the
+** final error message is the same either way.
+*/
+
+static mpc_ast_t *mpc_ast_copy(mpc_ast_t *a) {
+  int j;
+  mpc_ast_t *b;
+  if (a == NULL) { return NULL; }
+  b = mpc_ast_new(a->tag, a->contents);
+  b->state = a->state;
+  for (j = 0; j < a->children_num; j++) {
+    mpc_ast_add_child(b, mpc_ast_copy(a->children[j]));
+  }
+  return b;
+}
+
+static int mpc_input_memo_usable(mpc_input_t *i) {
+  return i->type == MPC_INPUT_STRING && i->backtrack >= 1;
+}
+
+static mpc_memo_t *mpc_input_memo_slot(mpc_input_t *i, mpc_parser_t *p) {
+  size_t h;
+  if (i->memo == NULL) { i->memo = calloc(MPC_INPUT_MEMO_NUM, sizeof(mpc_memo_t)); }
+  h = ((size_t)p >> 4) * 31 + (size_t)i->state.pos;
+  return &i->memo[h % MPC_INPUT_MEMO_NUM];
+}
+
+static int mpc_input_memo_hit(mpc_input_t *i, mpc_memo_t *m, mpc_parser_t *p) {
+  mpc_parse_totals.memo_lookups++;
+  if (m->parser != p
+  ||  m->pos != i->state.pos
+  ||  m->suppress != (i->suppress > 0)) { return 0; }
+  mpc_parse_totals.memo_hits++;
+  return 1;
+}
+
+static mpc_err_t *mpc_memo_err_keep(mpc_input_t *i, mpc_err_t *x) {
+  return x ? mpc_err_export(i, mpc_err_copy(i, x)) : NULL;
+}
+
+static void mpc_input_memo_store(mpc_input_t *i, mpc_memo_t *m, mpc_parser_t *p, long pos,
+  int success, mpc_result_t *r, mpc_err_t *merged) {
+  
+  if (m->parser) {
+    mpc_parse_totals.memo_evictions++;
+    mpc_ast_delete(m->output);
+    if (m->error) { mpc_err_delete(m->error); }
+    if (m->merged) { mpc_err_delete(m->merged); }
+  }
+  
+  mpc_parse_totals.memo_stores++;
+  m->parser = p;
+  m->pos = pos;
+  m->suppress = i->suppress > 0;
+  m->success = success;
+  m->state = i->state;
+  m->last = i->last;
+  m->output = success ? mpc_ast_copy(r->output) : NULL;
+  m->error = success ? NULL : mpc_memo_err_keep(i, r->error);
+  m->merged = mpc_memo_err_keep(i, merged);
+}
+
 enum {
   MPC_PARSE_STACK_MIN = 4
 };
@@ -1012,6 +1398,9 @@ static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_e
   mpc_result_t results_stk[MPC_PARSE_STACK_MIN];
   mpc_result_t *results;
   int results_slots = MPC_PARSE_STACK_MIN;
+  mpc_memo_t *m;
+  mpc_err_t *merged = NULL;
+  long pos;
   
   switch (p->type) {
       
@@ -1071,6 +1460,42 @@ static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_e
         MPC_FAILURE(r->error);
       }
     
+    /*
+    ** With errors on, the regex's combinator tree
+    ** also records what each repeat expected next,
+    ** which the DFA cannot, so it runs the tree.
+    */
+    
+    case MPC_TYPE_DFA:
+      if (i->suppress) {
+        if (mpc_input_dfa(i, p->data.dfa.dfa, (char**)&r->output)) { MPC_SUCCESS(r->output); }
+        if (i->backtrack >= 1) { MPC_FAILURE(NULL); }
+      }
+      return mpc_parse_run(i, p->data.dfa.x, r, e);
+    
+    case MPC_TYPE_MEMO:
+      if (!mpc_input_memo_usable(i)) {
+        return mpc_parse_run(i, p->data.memo.x, r, e);
+      }
+      
+      m = mpc_input_memo_slot(i, p);
+      if (mpc_input_memo_hit(i, m, p)) {
+        *e = mpc_err_merge(i, *e, mpc_err_copy(i, m->merged));
+        if (m->success) {
+          i->state = m->state;
+          i->last = m->last;
+          MPC_SUCCESS(mpc_ast_copy(m->output));
+        } else {
+          MPC_FAILURE(mpc_err_copy(i, m->error));
+        }
+      }
+      
+      pos = i->state.pos;
+      j = mpc_parse_run(i, p->data.memo.x, r, &merged);
+      mpc_input_memo_store(i, m, p, pos, j, r, merged);
+      *e = mpc_err_merge(i, *e, merged);
+      return j;
+    
     /* Optional Parsers */
     
     /* TODO: Update Not Error Message */
@@ -1232,7 +1657,16 @@ static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_e
 #undef MPC_FAILURE
 #undef MPC_PRIMITIVE
 
-int mpc_parse_input(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r) {
+/*
+** Errors are only built when a parse fails. The
+** first run suppresses them, so a successful parse
+** allocates none. A failed one is run again from
+** the start with errors on to build the message.
+** Inputs that cannot seek back to the start, like
+** pipes, keep all they read during the first run.
+*/
+
+static int mpc_parse_input_errors(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r) {
   int x;
   mpc_err_t *e = mpc_err_fail(i, "Unknown Error");
   e->state = mpc_state_invalid();
@@ -1246,6 +1680,54 @@ int mpc_parse_input(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r) {
   return x;
 }
 
+static int mpc_parse_input_lazy(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r) {
+  mpc_err_t *e = NULL;
+  
+  i->buffer_keep = i->type != MPC_INPUT_STRING && i->origin < 0;
+  
+  mpc_input_suppress_enable(i);
+  if (mpc_parse_run(i, p, r, &e)) {
+    mpc_input_suppress_disable(i);
+    i->buffer_keep = 0;
+    r->output = mpc_export(i, r->output);
+    return 1;
+  }
+  mpc_input_suppress_disable(i);
+  
+  mpc_parse_totals.reparses++;
+  mpc_input_reset(i);
+  return mpc_parse_input_errors(i, p, r);
+}
+
+int mpc_parse_input(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r) {
+  
+  int x;
+  mpc_arena_t *outer = mpc_arena_current;
+  mpc_arena_t *arena;
+  
+  if (!p->arena) {
+    mpc_arena_current = NULL;
+    x = mpc_parse_input_lazy(i, p, r);
+    mpc_arena_current = outer;
+    return x;
+  }
+  
+  arena = mpc_arena_new();
+  mpc_arena_current = arena;
+  x = mpc_parse_input_lazy(i, p, r);
+  mpc_arena_current = outer;
+  
+  /* the memo may still hold nodes from the arena */
+  mpc_input_memo_clear(i);
+  
+  if (x && r->output && mpc_ast_head(r->output)->arena == arena) {
+    arena->root = r->output;
+  } else {
+    mpc_arena_delete(arena);
+  }
+  return x;
+}
+
 int mpc_parse(const char *filename, const char *string, mpc_parser_t *p, mpc_result_t *r) {
   int x;
   mpc_input_t *i = mpc_input_new_string(filename, string);
@@ -1300,6 +1782,32 @@ int mpc_parse_contents(const char *filename, mpc_parser_t *p, mpc_result_t *r) {
 
 static void mpc_undefine_unretained(mpc_parser_t *p, int force);
 
+static void mpc_dfa_delete(mpc_dfa_t *d) {
+  int j;
+  for (j = 0; j < d->n; j++) {
+    free(d->branches[j].table);
+    free(d->branches[j].accept);
+  }
+  free(d->branches);
+  free(d);
+}
+
+static mpc_dfa_t *mpc_dfa_copy(mpc_dfa_t *d) {
+  int j, n;
+  mpc_dfa_t *c = malloc(sizeof(mpc_dfa_t));
+  c->n = d->n;
+  c->branches = malloc(sizeof(mpc_dfa_branch_t) * d->n);
+  for (j = 0; j < d->n; j++) {
+    n = d->branches[j].states;
+    c->branches[j] = d->branches[j];
+    c->branches[j].table = malloc(sizeof(int) * n * 256);
+    memcpy(c->branches[j].table, d->branches[j].table, sizeof(int) * n * 256);
+    c->branches[j].accept = malloc(n);
+    memcpy(c->branches[j].accept, d->branches[j].accept, n);
+  }
+  return c;
+}
+
 static void mpc_undefine_or(mpc_parser_t *p) {
   
   int i;
@@ -1338,6 +1846,12 @@ static void mpc_undefine_unretained(mpc_parser_t *p, int force) {
     case MPC_TYPE_APPLY:    mpc_undefine_unretained(p->data.apply.x, 0);    break;
     case MPC_TYPE_APPLY_TO: mpc_undefine_unretained(p->data.apply_to.x, 0); break;
     case MPC_TYPE_PREDICT:  mpc_undefine_unretained(p->data.predict.x, 0);  break;
+    case MPC_TYPE_MEMO:     mpc_undefine_unretained(p->data.memo.x, 0);     break;
+    
+    case MPC_TYPE_DFA:
+      mpc_undefine_unretained(p->data.dfa.x, 0);
+      mpc_dfa_delete(p->data.dfa.dfa);
+      break;
     
     case MPC_TYPE_MAYBE:
     case MPC_TYPE_NOT:
@@ -1413,6 +1927,7 @@ mpc_parser_t *mpc_copy(mpc_parser_t *a) {
   p->retained = a->retained;
   p->type = a->type;
   p->data = a->data;
+  p->arena = a->arena;
   
   if (a->name) {
     p->name = malloc(strlen(a->name)+1);
@@ -1436,6 +1951,12 @@ mpc_parser_t *mpc_copy(mpc_parser_t *a) {
     case MPC_TYPE_APPLY:    p->data.apply.x    = mpc_copy(a->data.apply.x);    break;
     case MPC_TYPE_APPLY_TO: p->data.apply_to.x = mpc_copy(a->data.apply_to.x); break;
     case MPC_TYPE_PREDICT:  p->data.predict.x  = mpc_copy(a->data.predict.x);  break;
+    case MPC_TYPE_MEMO:     p->data.memo.x     = mpc_copy(a->data.memo.x);     break;
+    
+    case MPC_TYPE_DFA:
+      p->data.dfa.x = mpc_copy(a->data.dfa.x);
+      p->data.dfa.dfa = mpc_dfa_copy(a->data.dfa.dfa);
+      break;
     
     case MPC_TYPE_MAYBE:
     case MPC_TYPE_NOT:
@@ -2097,20 +2618,14 @@ static const char *mpc_re_range_escape_char(char c) {
   }
 }
 
-static mpc_val_t *mpcf_re_range(mpc_val_t *x) {
+/* The characters a range expression `s` lists, after a leading '^' if `comp` */
+static char *mpc_re_range_chars(const char *s, int comp) {
   
-  mpc_parser_t *out;
   size_t i, j;
   size_t start, end;
   const char *tmp = NULL;
-  const char *s = x;
-  int comp = s[0] == '^' ? 1 : 0;
   char *range = calloc(1,1);
   
-  if (s[0] == '\0') { free(x); return mpc_fail("Invalid Regex Range Expression"); } 
-  if (s[0] == '^' && 
-      s[1] == '\0') { free(x); return mpc_fail("Invalid Regex Range Expression"); }
-  
   for (i = comp; i < strlen(s); i++){
     
     /* Regex Range Escape */
@@ -2152,6 +2667,21 @@ static mpc_val_t *mpcf_re_range(mpc_val_t *x) {
   
   }
   
+  return range;
+}
+
+static mpc_val_t *mpcf_re_range(mpc_val_t *x) {
+  
+  mpc_parser_t *out;
+  const char *s = x;
+  int comp = s[0] == '^' ? 1 : 0;
+  char *range;
+  
+  if (s[0] == '\0') { free(x); return mpc_fail("Invalid Regex Range Expression"); } 
+  if (s[0] == '^' && 
+      s[1] == '\0') { free(x); return mpc_fail("Invalid Regex Range Expression"); }
+  
+  range = mpc_re_range_chars(s, comp);
   out = comp == 1 ? mpc_noneof(range) : mpc_oneof(range);
   
   free(x);
@@ -2160,12 +2690,189 @@ static mpc_val_t *mpcf_re_range(mpc_val_t *x) {
   return out;
 }
 
+/*
+** ### Regular Expression DFA
+**
+** Regexes made only of characters, escapes, `.`,
+** ranges, `^` first, `$`, and `*` `+` `?` on any
+** but the anchors, optionally split by top level
+** `|`, are also compiled to a DFA.
+**
+** The combinator tree repeats greedily and never
+** gives characters back, so every such regex is
+** deterministic already. Each state is a factor,
+** and whether a `+` on it has matched once yet.
+** Anything else is left to the tree alone.
+*/
+
+enum {
+  MPC_DFA_ANCHOR_NONE = 0,
+  MPC_DFA_ANCHOR_SOI  = 1,
+  MPC_DFA_ANCHOR_EOI  = 2
+};
+
+typedef struct {
+  char set[256];
+  int anchor;
+  char q;
+} mpc_dfa_factor_t;
+
+static int mpc_dfa_set_chars(mpc_dfa_factor_t *f, const char *chars) {
+  for (; *chars; chars++) { f->set[(unsigned char)*chars] = 1; }
+  return 1;
+}
+
+/* Reads one factor at `*re`, 0 if the DFA cannot express it */
+static int mpc_dfa_factor(const char **re, mpc_dfa_factor_t *f) {
+  
+  const char *s = *re;
+  const char *tmp;
+  char *body, *range;
+  size_t j;
+  int k;
+  
+  memset(f, 0, sizeof(mpc_dfa_factor_t));
+  
+  switch (s[0]) {
+    
+    case '(': case ')': case '{': return 0;
+    
+    case '[':
+      for (j = 1; s[j] && s[j] != ']'; j++) {
+        if (s[j] == '\\') { if (!s[j+1]) { return 0; } j++; }
+      }
+      if (!s[j] || j == 1 || (j == 2 && s[1] == '^')) { return 0; }
+      body = malloc(j);
+      memcpy(body, s + 1, j - 1);
+      body[j - 1] = '\0';
+      range = mpc_re_range_chars(body, body[0] == '^');
+      mpc_dfa_set_chars(f, range);
+      if (body[0] == '^') {
+        for (k = 1; k < 256; k++) { f->set[k] = !f->set[k]; }
+      }
+      free(range);
+      free(body);
+      s += j + 1;
+      break;
+    
+    case '\\':
+      if (!s[1]) { return 0; }
+      switch (s[1]) {
+        case 'a': f->set['\a'] = 1; break;
+        case 'f': f->set['\f'] = 1; break;
+        case 'n': f->set['\n'] = 1; break;
+        case 'r': f->set['\r'] = 1; break;
+        case 't': f->set['\t'] = 1; break;
+        case 'v': f->set['\v'] = 1; break;
+        case 'd': mpc_dfa_set_chars(f, "0123456789"); break;
+        case 's': mpc_dfa_set_chars(f, " \f\n\r\t\v"); break;
+        case 'w': tmp = mpc_re_range_escape_char('w'); mpc_dfa_set_chars(f, tmp); break;
+        case 'b': case 'B': case 'A': case 'Z':
+        case 'D': case 'S': case 'W': return 0;
+        default: f->set[(unsigned char)s[1]] = 1;
+      }
+      s += 2;
+      break;
+    
+    case '.': for (k = 1; k < 256; k++) { f->set[k] = 1; } s++; break;
+    case '^': f->anchor = MPC_DFA_ANCHOR_SOI; s++; break;
+    case '$': f->anchor = MPC_DFA_ANCHOR_EOI; s++; break;
+    default: f->set[(unsigned char)s[0]] = 1; s++;
+  }
+  
+  if (s[0] == '*' || s[0] == '+' || s[0] == '?') {
+    if (f->anchor) { return 0; }
+    f->q = s[0];
+    s++;
+  }
+  if (s[0] == '{') { return 0; }
+  
+  *re = s;
+  return 1;
+}
+
+/* Where state `k*2+once` goes on character `c` */
+static int mpc_dfa_step(mpc_dfa_factor_t *fs, int n, int k, int once, int c) {
+  while (k < n) {
+    if (fs[k].anchor == MPC_DFA_ANCHOR_SOI) { k++; once = 0; continue; }
+    if (fs[k].anchor == MPC_DFA_ANCHOR_EOI) { return MPC_DFA_FAIL; }
+    switch (fs[k].q) {
+      case '*': if (fs[k].set[c]) { return k*2+1; } break;
+      case '+': if (fs[k].set[c]) { return k*2+1; } if (!once) { return MPC_DFA_FAIL; } break;
+      case '?': if (fs[k].set[c]) { return (k+1)*2; } break;
+      default:  return fs[k].set[c] ? (k+1)*2 : MPC_DFA_FAIL;
+    }
+    k++;
+    once = 0;
+  }
+  return MPC_DFA_STOP;
+}
+
+/* Whether the match succeeds if the input ends in state `k*2+once` */
+static int mpc_dfa_accept(mpc_dfa_factor_t *fs, int n, int k, int once) {
+  for (; k < n; k++, once = 0) {
+    if (fs[k].anchor) { continue; }
+    if (fs[k].q == 0 || (fs[k].q == '+' && !once)) { return 0; }
+  }
+  return 1;
+}
+
+static int mpc_dfa_branch(const char **re, mpc_dfa_branch_t *b) {
+  
+  mpc_dfa_factor_t *fs = NULL;
+  int n = 0, k, once, c;
+  
+  while (**re && **re != '|') {
+    fs = realloc(fs, sizeof(mpc_dfa_factor_t) * (n + 1));
+    if (!mpc_dfa_factor(re, &fs[n])) { free(fs); return 0; }
+    if (fs[n].anchor == MPC_DFA_ANCHOR_SOI && n > 0) { free(fs); return 0; }
+    n++;
+  }
+  
+  b->soi = n > 0 && fs[0].anchor == MPC_DFA_ANCHOR_SOI;
+  b->states = n * 2 + 1;
+  b->table = malloc(sizeof(int) * b->states * 256);
+  b->accept = malloc(b->states);
+  
+  for (k = 0; k <= n; k++) {
+    for (once = 0; once < 2; once++) {
+      if (k == n && once) { continue; }
+      b->accept[k*2+once] = (char)mpc_dfa_accept(fs, n, k, once);
+      for (c = 0; c < 256; c++) {
+        b->table[(k*2+once) * 256 + c] = mpc_dfa_step(fs, n, k, once, c);
+      }
+    }
+  }
+  
+  free(fs);
+  return 1;
+}
+
+static mpc_dfa_t *mpc_dfa_compile(const char *re) {
+  
+  mpc_dfa_t *d = malloc(sizeof(mpc_dfa_t));
+  d->n = 0;
+  d->branches = NULL;
+  
+  for (;;) {
+    d->branches = realloc(d->branches, sizeof(mpc_dfa_branch_t) * (d->n + 1));
+    if (!mpc_dfa_branch(&re, &d->branches[d->n])) { mpc_dfa_delete(d); return NULL; }
+    d->n++;
+    if (*re != '|') { break; }
+    re++;
+  }
+  
+  return d;
+}
+
 mpc_parser_t *mpc_re(const char *re) {
   
   char *err_msg;
   mpc_parser_t *err_out;
   mpc_result_t r;
   mpc_parser_t *Regex, *Term, *Factor, *Base, *Range, *RegexEnclose; 
+  mpc_parser_t *p;
+  mpc_dfa_t *dfa;
   
   Regex  = mpc_new("regex");
   Term   = mpc_new("term");
@@ -2223,6 +2930,15 @@ mpc_parser_t *mpc_re(const char *re) {
   
   mpc_optimise(r.output);
   
+  dfa = mpc_dfa_compile(re);
+  if (dfa) {
+    p = mpc_undefined();
+    p->type = MPC_TYPE_DFA;
+    p->data.dfa.x = r.output;
+    p->data.dfa.dfa = dfa;
+    return p;
+  }
+  
   return r.output;
   
 }
@@ -2568,6 +3284,8 @@ static void mpc_print_unretained(mpc_parser_t *p, int force) {
   if (p->type == MPC_TYPE_APPLY)    { mpc_print_unretained(p->data.apply.x, 0); }
   if (p->type == MPC_TYPE_APPLY_TO) { mpc_print_unretained(p->data.apply_to.x, 0); }
   if (p->type == MPC_TYPE_PREDICT)  { mpc_print_unretained(p->data.predict.x, 0); }
+  if (p->type == MPC_TYPE_MEMO)     { mpc_print_unretained(p->data.memo.x, 0); }
+  if (p->type == MPC_TYPE_DFA)      { mpc_print_unretained(p->data.dfa.x, 0); }
 
   if (p->type == MPC_TYPE_NOT)   { mpc_print_unretained(p->data.not.x, 0); printf("!"); }
   if (p->type == MPC_TYPE_MAYBE) { mpc_print_unretained(p->data.not.x, 0); printf("?"); }
@@ -2676,9 +3394,16 @@ int mpc_test_pass(mpc_parser_t *p, const char *s, const void *d,
 void mpc_ast_delete(mpc_ast_t *a) {
   
   int i;
+  mpc_arena_t *arena;
   
   if (a == NULL) { return; }
   
+  arena = mpc_ast_head(a)->arena;
+  if (arena) {
+    if (arena->root == a) { mpc_arena_delete(arena); }
+    return;
+  }
+  
   for (i = 0; i < a->children_num; i++) {
     mpc_ast_delete(a->children[i]);
   }
@@ -2686,26 +3411,54 @@ void mpc_ast_delete(mpc_ast_t *a) {
   free(a->children);
   free(a->tag);
   free(a->contents);
-  free(a);
+  free(mpc_ast_head(a));
   
 }
 
 static void mpc_ast_delete_no_children(mpc_ast_t *a) {
+  if (mpc_ast_head(a)->arena) { return; }
   free(a->children);
   free(a->tag);
   free(a->contents);
-  free(a);
+  free(mpc_ast_head(a));
+}
+
+/* Replaces the tag with the n chars at s */
+static void mpc_ast_set_tag(mpc_ast_t *a, const char *s, size_t n) {
+  mpc_arena_t *arena = mpc_ast_head(a)->arena;
+  if (arena) {
+    a->tag = mpc_arena_intern(arena, s, n);
+  } else {
+    a->tag = realloc(a->tag, n + 1);
+    memmove(a->tag, s, n);
+    a->tag[n] = '\0';
+  }
 }
 
 mpc_ast_t *mpc_ast_new(const char *tag, const char *contents) {
   
-  mpc_ast_t *a = malloc(sizeof(mpc_ast_t));
+  mpc_arena_t *arena = mpc_arena_current;
+  mpc_ast_head_t *h;
+  mpc_ast_t *a;
   
-  a->tag = malloc(strlen(tag) + 1);
-  strcpy(a->tag, tag);
+  if (arena) {
+    h = mpc_arena_alloc(arena, sizeof(mpc_ast_head_t) + sizeof(mpc_ast_t));
+  } else {
+    h = malloc(sizeof(mpc_ast_head_t) + sizeof(mpc_ast_t));
+  }
+  h->arena = arena;
+  h->children_slots = 0;
+  a = (mpc_ast_t*)(h + 1);
   
-  a->contents = malloc(strlen(contents) + 1);
-  strcpy(a->contents, contents);
+  if (arena) {
+    a->tag = mpc_arena_intern(arena, tag, strlen(tag));
+    a->contents = mpc_arena_strndup(arena, contents, strlen(contents));
+  } else {
+    a->tag = malloc(strlen(tag) + 1);
+    strcpy(a->tag, tag);
+    a->contents = malloc(strlen(contents) + 1);
+    strcpy(a->contents, contents);
+  }
   
   a->state = mpc_state_new();
   
@@ -2762,32 +3515,57 @@ int mpc_ast_eq(mpc_ast_t *a, mpc_ast_t *b) {
 }
 
 mpc_ast_t *mpc_ast_add_child(mpc_ast_t *r, mpc_ast_t *a) {
-  r->children_num++;
-  r->children = realloc(r->children, sizeof(mpc_ast_t*) * r->children_num);
-  r->children[r->children_num-1] = a;
+  
+  mpc_ast_head_t *h = mpc_ast_head(r);
+  mpc_ast_t **children;
+  
+  /* children arrays grow by doubling, in the arena the old one is left behind */
+  if (r->children_num == h->children_slots) {
+    h->children_slots = h->children_slots ? h->children_slots * 2 : 4;
+    if (h->arena) {
+      children = mpc_arena_alloc(h->arena, sizeof(mpc_ast_t*) * h->children_slots);
+      if (r->children_num) { memcpy(children, r->children, sizeof(mpc_ast_t*) * r->children_num); }
+      r->children = children;
+    } else {
+      r->children = realloc(r->children, sizeof(mpc_ast_t*) * h->children_slots);
+    }
+  }
+  
+  r->children[r->children_num++] = a;
   return r;
 }
 
 mpc_ast_t *mpc_ast_add_tag(mpc_ast_t *a, const char *t) {
+  size_t lt, lo;
+  char stk[256], *tag;
   if (a == NULL) { return a; }
-  a->tag = realloc(a->tag, strlen(t) + 1 + strlen(a->tag) + 1);
-  memmove(a->tag + strlen(t) + 1, a->tag, strlen(a->tag)+1);
-  memmove(a->tag, t, strlen(t));
-  memmove(a->tag + strlen(t), "|", 1);
+  lt = strlen(t);
+  lo = strlen(a->tag);
+  tag = lt + 1 + lo <= sizeof(stk) ? stk : malloc(lt + 1 + lo);
+  memcpy(tag, t, lt);
+  tag[lt] = '|';
+  memcpy(tag + lt + 1, a->tag, lo);
+  mpc_ast_set_tag(a, tag, lt + 1 + lo);
+  if (tag != stk) { free(tag); }
   return a;
 }
 
 mpc_ast_t *mpc_ast_add_root_tag(mpc_ast_t *a, const char *t) {
+  size_t lt, lo;
+  char stk[256], *tag;
   if (a == NULL) { return a; }
-  a->tag = realloc(a->tag, (strlen(t)-1) + strlen(a->tag) + 1);
-  memmove(a->tag + (strlen(t)-1), a->tag, strlen(a->tag)+1);
-  memmove(a->tag, t, (strlen(t)-1));
+  lt = strlen(t) - 1;
+  lo = strlen(a->tag);
+  tag = lt + lo <= sizeof(stk) ? stk : malloc(lt + lo);
+  memcpy(tag, t, lt);
+  memcpy(tag + lt, a->tag, lo);
+  mpc_ast_set_tag(a, tag, lt + lo);
+  if (tag != stk) { free(tag); }
   return a;
 }
 
 mpc_ast_t *mpc_ast_tag(mpc_ast_t *a, const char *t) {
-  a->tag = realloc(a->tag, strlen(t) + 1);
-  strcpy(a->tag, t);
+  mpc_ast_set_tag(a, t, strlen(t));
   return a;
 }
 
@@ -3056,6 +3834,13 @@ mpc_parser_t *mpca_state(mpc_parser_t *a) {
   return mpc_and(2, mpcf_state_ast, mpc_state(), a, free);
 }
 
+mpc_parser_t *mpca_memo(mpc_parser_t *a) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_MEMO;
+  p->data.memo.x = a;
+  return p;
+}
+
 mpc_parser_t *mpca_tag(mpc_parser_t *a, const char *t) {
   return mpc_apply_to(a, (mpc_apply_to_t)mpc_ast_tag, (void*)t);
 }
@@ -3441,8 +4226,10 @@ static mpc_val_t *mpca_stmt_list_apply_to(mpc_val_t *x, void *s) {
     left = mpca_grammar_find_parser(stmt->ident, st);
     if (st->flags & MPCA_LANG_PREDICTIVE) { stmt->grammar = mpc_predictive(stmt->grammar); }
     if (stmt->name) { stmt->grammar = mpc_expect(stmt->grammar, stmt->name); }
+    if (st->flags & MPCA_LANG_PACKRAT) { stmt->grammar = mpca_memo(stmt->grammar); }
     mpc_optimise(stmt->grammar);
     mpc_define(left, stmt->grammar);
+    if (st->flags & MPCA_LANG_ARENA) { left->arena = 1; }
     free(stmt->ident);
     free(stmt->name);
     free(stmt);
@@ -3635,6 +4422,8 @@ static int mpc_nodecount_unretained(mpc_parser_t* p, int force) {
   if (p->type == MPC_TYPE_APPLY)    { return 1 + mpc_nodecount_unretained(p->data.apply.x, 0); }
   if (p->type == MPC_TYPE_APPLY_TO) { return 1 + mpc_nodecount_unretained(p->data.apply_to.x, 0); }
   if (p->type == MPC_TYPE_PREDICT)  { return 1 + mpc_nodecount_unretained(p->data.predict.x, 0); }
+  if (p->type == MPC_TYPE_MEMO)     { return 1 + mpc_nodecount_unretained(p->data.memo.x, 0); }
+  if (p->type == MPC_TYPE_DFA)      { return 1 + mpc_nodecount_unretained(p->data.dfa.x, 0); }
 
   if (p->type == MPC_TYPE_NOT)   { return 1 + mpc_nodecount_unretained(p->data.not.x, 0); }
   if (p->type == MPC_TYPE_MAYBE) { return 1 + mpc_nodecount_unretained(p->data.not.x, 0); }
@@ -3682,6 +4471,8 @@ static void mpc_optimise_unretained(mpc_parser_t *p, int force) {
   if (p->type == MPC_TYPE_APPLY)    { mpc_optimise_unretained(p->data.apply.x, 0); }
   if (p->type == MPC_TYPE_APPLY_TO) { mpc_optimise_unretained(p->data.apply_to.x, 0); }
   if (p->type == MPC_TYPE_PREDICT)  { mpc_optimise_unretained(p->data.predict.x, 0); }
+  if (p->type == MPC_TYPE_MEMO)     { mpc_optimise_unretained(p->data.memo.x, 0); }
+  if (p->type == MPC_TYPE_DFA)      { mpc_optimise_unretained(p->data.dfa.x, 0); }
   if (p->type == MPC_TYPE_NOT)      { mpc_optimise_unretained(p->data.not.x, 0); }
   if (p->type == MPC_TYPE_MAYBE)    { mpc_optimise_unretained(p->data.not.x, 0); }
   if (p->type == MPC_TYPE_MANY)     { mpc_optimise_unretained(p->data.repeat.x, 0); }
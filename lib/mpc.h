@@ -70,6 +70,18 @@ int mpc_parse_file(const char *filename, FILE *file, mpc_parser_t *p, mpc_result
 int mpc_parse_pipe(const char *filename, FILE *pipe, mpc_parser_t *p, mpc_result_t *r);
 int mpc_parse_contents(const char *filename, mpc_parser_t *p, mpc_result_t *r);
 
+typedef struct {
+  long memo_lookups;
+  long memo_hits;
+  long memo_stores;
+  long memo_evictions;
+  long errors;      /* error objects built */
+  long reparses;    /* failed parses run again to build their error */
+} mpc_parse_stats_t;
+
+/* Totals over every parse so far */
+void mpc_parse_stats(mpc_parse_stats_t *s);
+
 /*
 ** Function Types
 */
@@ -321,6 +333,14 @@ mpc_parser_t *mpca_root(mpc_parser_t *a);
 mpc_parser_t *mpca_state(mpc_parser_t *a);
 mpc_parser_t *mpca_total(mpc_parser_t *a);
 
+/*
+** Packrat memoisation of a parser producing ASTs.
+** Each position of a string input is parsed at most
+** once per parser, within a bounded cache.
+*/
+
+mpc_parser_t *mpca_memo(mpc_parser_t *a);
+
 mpc_parser_t *mpca_not(mpc_parser_t *a);
 mpc_parser_t *mpca_maybe(mpc_parser_t *a);
 
@@ -334,9 +354,19 @@ mpc_parser_t *mpca_and(int n, ...);
 enum {
   MPCA_LANG_DEFAULT              = 0,
   MPCA_LANG_PREDICTIVE           = 1,
-  MPCA_LANG_WHITESPACE_SENSITIVE = 2
+  MPCA_LANG_WHITESPACE_SENSITIVE = 2,
+  MPCA_LANG_PACKRAT              = 4,
+  MPCA_LANG_ARENA                = 8
 };
 
+/*
+** With MPCA_LANG_ARENA every AST a rule's parse
+** returns lives in one arena with shared tags, and
+** mpc_ast_delete on the root frees it all at once.
+** Subtrees live exactly as long as the root, and
+** tags must not be written to.
+*/
+
 mpc_parser_t *mpca_grammar(int flags, const char *grammar, ...);
 
 mpc_err_t *mpca_lang(int flags, const char *language, ...);
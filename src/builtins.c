@@ -1,95 +1,172 @@
+#include <limits.h>
+
 #include "builtins.h"
+#include "lmem.h"
+#include "lgc.h"
+#include "lvm.h"
+#include "lload.h"
+
+// arithmetic kernels
+// ------------------
+// one per operator, each folds its arguments in a single pass over the
+// array and never allocates for a fixnum result. overflow is an error.
+static lval* arith_check(lval** args, int n){
+  if(n == 0){ return lval_err("Arithmetic needs at least one number"); }
+  for(int i = 0; i < n; i++){
+    if(lval_type(args[i]) != LVAL_NUM){
+      return lval_err("Invalid type: expected `%s`, got: `%s`", ltype_name(LVAL_NUM), ltype_name(lval_type(args[i])));
+    }
+  }
+  return NULL;
+}
+
+static lval* arith_add(lval** args, int n){
+  lval* err = arith_check(args, n);
+  if(err != NULL){ return err; }
 
-// add, sub, mul, div functions
-lval* builtin_op(lenv* e, lval* a, char* op){
-  for (int i = 0; i < a->count; i++){
-    LASSERT(a, a->cell[i]->type == LVAL_NUM,
-      "Invalid type: expected `%s`, got: `%s`", ltype_name(LVAL_NUM), ltype_name(a->cell[i]->type));
+  long acc = lval_num_value(args[0]);
+  for(int i = 1; i < n; i++){
+    if(__builtin_add_overflow(acc, lval_num_value(args[i]), &acc)){
+      return lval_err("Integer overflow");
+    }
   }
+  return lval_num(acc);
+}
 
-  lval* x = lval_pop(a, 0);
+static lval* arith_sub(lval** args, int n){
+  lval* err = arith_check(args, n);
+  if(err != NULL){ return err; }
 
-  if((strcmp(op, "-") == 0) && a->count == 0){
-    x->num = -x->num;
+  long acc = lval_num_value(args[0]);
+  // a single operand is negated
+  if(n == 1 && __builtin_sub_overflow(0, acc, &acc)){
+    return lval_err("Integer overflow");
+  }
+  for(int i = 1; i < n; i++){
+    if(__builtin_sub_overflow(acc, lval_num_value(args[i]), &acc)){
+      return lval_err("Integer overflow");
+    }
   }
+  return lval_num(acc);
+}
+
+static lval* arith_mul(lval** args, int n){
+  lval* err = arith_check(args, n);
+  if(err != NULL){ return err; }
 
-  while (a->count > 0){
-    lval* y = lval_pop(a, 0);
-
-    if(strcmp(op, "+") == 0){ x->num += y->num; }
-    if(strcmp(op, "-") == 0){ x->num -= y->num; }
-    if(strcmp(op, "*") == 0){ x->num *= y->num; }
-    if(strcmp(op, "/") == 0){
-      if(y->num == 0){
-        lval_del(x); lval_del(y);
-        x = lval_err("Division by zero"); break;
-      }
-      x->num /= y->num;
+  long acc = lval_num_value(args[0]);
+  for(int i = 1; i < n; i++){
+    if(__builtin_mul_overflow(acc, lval_num_value(args[i]), &acc)){
+      return lval_err("Integer overflow");
     }
+  }
+  return lval_num(acc);
+}
+
+static lval* arith_div(lval** args, int n){
+  lval* err = arith_check(args, n);
+  if(err != NULL){ return err; }
 
-    lval_del(y);
+  long acc = lval_num_value(args[0]);
+  for(int i = 1; i < n; i++){
+    long y = lval_num_value(args[i]);
+    if(y == 0){ return lval_err("Division by zero"); }
+    if(y == -1 && acc == LONG_MIN){ return lval_err("Integer overflow"); }
+    acc /= y;
   }
+  return lval_num(acc);
+}
+
+larith builtin_arith(lbuiltin f){
+  if(f == builtin_add){ return arith_add; }
+  if(f == builtin_sub){ return arith_sub; }
+  if(f == builtin_mul){ return arith_mul; }
+  if(f == builtin_div){ return arith_div; }
+  return NULL;
+}
 
-  lval_del(a); return x;
+static lval* builtin_arith_apply(lval* v, larith kernel){
+  int n = lval_count(v);
+  lval* result = kernel(n > 0 ? v->cell : NULL, n);
+  lval_del(v);
+  return result;
 }
 
 lval* builtin_head(lenv* e, lval* v){
   LASSERT(v, v->count == 1,
     "Too many arguments passed to `head`, expected: 1, got: %i", v->count);
-  LASSERT(v, v->cell[0]->type == LVAL_QEXPR,
-    "`head` expects input of type `q-expression`, got: `%s`", ltype_name(v->cell[0]->type));
-  LASSERT(v, v->cell[0]->count != 0,
+  LASSERT(v, lval_type(v->cell[0]) == LVAL_QEXPR,
+    "`head` expects input of type `q-expression`, got: `%s`", ltype_name(lval_type(v->cell[0])));
+  LASSERT(v, lval_count(v->cell[0]) != 0,
     "`head` was passed list {}, `head` is undefined for {}");
 
+  // the argument may be shared, build a fresh one element list
   lval* argument_qexpr = lval_take(v, 0);
-  // unsure why I can't just lval_take(argument_qexpr, 0)
-  while(argument_qexpr->count > 1){ lval_del(lval_pop(argument_qexpr, 1)); }
-  return argument_qexpr;
+  lval* first = lval_copy(argument_qexpr->cell[0]);
+  lval_del(argument_qexpr);
+  return lval_list(LVAL_QEXPR, &first, 1);
 }
 
 lval* builtin_tail(lenv* e, lval* v){
   LASSERT(v, v->count == 1,
     "Too many arguments passed to `tail`, expected: 1, got: %i", v->count);
-  LASSERT(v, v->cell[0]->type == LVAL_QEXPR,
-    "`tail` expects input of type `q-expression`, got: %s", ltype_name(v->cell[0]->type));
-  LASSERT(v, v->cell[0]->count != 0,
+  LASSERT(v, lval_type(v->cell[0]) == LVAL_QEXPR,
+    "`tail` expects input of type `q-expression`, got: %s", ltype_name(lval_type(v->cell[0])));
+  LASSERT(v, lval_count(v->cell[0]) != 0,
     "`tail` was passed list {}, `tail` is undefined for {}");
 
-  lval* list = lval_take(v, 0);
-  lval_del(lval_pop(list, 0));
-  return list;
+  // shares the rest of the list when it is shared
+  return lval_rest(lval_take(v, 0));
+}
+
+// cons x {xs} -> {x xs}
+lval* builtin_cons(lenv* e, lval* v){
+  LASSERT(v, v->count == 2,
+    "`cons` expects 2 arguments, got: %i", v->count);
+  LASSERT(v, lval_type(v->cell[1]) == LVAL_QEXPR,
+    "`cons` expects a `q-expression` to cons onto, got: `%s`", ltype_name(lval_type(v->cell[1])));
+
+  lval* x = lval_pop(v, 0);
+  return lval_cons(x, lval_take(v, 0));
 }
 
 // takes an S-expression and returns the contents as a Q-expression
 // list(s...) -> q(s...)
 lval* builtin_list(lenv* e, lval* v){
-  v->type = LVAL_QEXPR;
-  return v;
+  return lval_retype(v, LVAL_QEXPR);
 }
 
 // takes a qexpression that is not {} and returns the contents evalutated
-lval* builtin_eval(lenv* e, lval* v){
+lval* builtin_eval_expr(lenv* e, lval* v){
   LASSERT(v, v->count == 1,
     "Too many arguments passed to `eval`");
-  LASSERT(v, v->cell[0]->type == LVAL_QEXPR,
+  LASSERT(v, lval_type(v->cell[0]) == LVAL_QEXPR,
     "Argument passed to `eval` should be Q-expression");
-  LASSERT(v, v->cell[0]->count != 0,
+  LASSERT(v, lval_count(v->cell[0]) != 0,
     "`eval` was passed {}, need non-empty Q-expression");
 
-  lval* x = lval_take(v, 0);
-  x->type = LVAL_SEXPR;
-  return lval_eval(e, x);
+  return lval_retype(lval_take(v, 0), LVAL_SEXPR);
+}
+
+lval* builtin_eval(lenv* e, lval* v){
+  return lval_eval(e, builtin_eval_expr(e, v));
 }
 
 lval* builtin_join(lenv* e, lval* qs){
   for(int i = 0; i < qs->count; i++){
-    LASSERT(qs, qs->cell[i]->type == LVAL_QEXPR,
+    LASSERT(qs, lval_type(qs->cell[i]) == LVAL_QEXPR,
       "Arguments passed to `join` need to be all Q-expressions");
   }
 
+  // size the result once, the joins below then only copy cells
+  int total = 0;
+  for(int i = 0; i < qs->count; i++){
+    total += lval_count(qs->cell[i]);
+  }
+
   // take out one q-expression
   // join {hoge} <this{fuga}> {piyo} ...
-  lval* x = lval_pop(qs, 0);
+  lval* x = lval_reserve(lval_pop(qs, 0), total);
 
   // while there are more q-expressions (piyo)
   // join the two q-expressions together
@@ -102,19 +179,19 @@ lval* builtin_join(lenv* e, lval* qs){
 }
 
 lval* builtin_add(lenv* e, lval* v){
-  return builtin_op(e, v, "+");
+  return builtin_arith_apply(v, arith_add);
 }
 
 lval* builtin_sub(lenv* e, lval* v){
-  return builtin_op(e, v, "-");
+  return builtin_arith_apply(v, arith_sub);
 }
 
 lval* builtin_mul(lenv* e, lval* v){
-  return builtin_op(e, v, "*");
+  return builtin_arith_apply(v, arith_mul);
 }
 
 lval* builtin_div(lenv* e, lval* v){
-  return builtin_op(e, v, "/");
+  return builtin_arith_apply(v, arith_div);
 }
 
 // bind globally
@@ -127,21 +204,21 @@ lval* builtin_put(lenv* e, lval* v){
 }
 
 lval* builtin_bind(lenv* e, lval* v, char* func){
-  LASSERT(v, v->cell[0]->type == LVAL_QEXPR,
-    "First argument to `%s` must be a q-expression, got: %s", func, ltype_name(v->cell[0]->type));
+  LASSERT(v, lval_type(v->cell[0]) == LVAL_QEXPR,
+    "First argument to `%s` must be a q-expression, got: %s", func, ltype_name(lval_type(v->cell[0])));
 
   // first argument is a list of symbols
   lval* symbols = v->cell[0];
 
-  for(int i = 0; i < symbols->count; i++){
-    LASSERT(v, symbols->cell[i]->type == LVAL_SYM,
+  for(int i = 0; i < lval_count(symbols); i++){
+    LASSERT(v, lval_type(symbols->cell[i]) == LVAL_SYM,
       "Cannot bind to invalid variable name");
   }
 
-  LASSERT(v, symbols->count == v->count - 1,
+  LASSERT(v, lval_count(symbols) == v->count - 1,
     "Number of symbols does not match number of expressions");
 
-  for (int i = 0; i < symbols->count; i++){
+  for (int i = 0; i < lval_count(symbols); i++){
     if(strcmp(func, "def") == 0){
       lenv_def(e, symbols->cell[i], v->cell[i+1]);
     }
@@ -157,16 +234,20 @@ lval* builtin_bind(lenv* e, lval* v, char* func){
 lval* builtin_lambda(lenv* e, lval* v){
   LASSERT(v, v->count == 2,
     "Expected %s arguments, got: %s", 2, v->count);
-  LASSERT(v, v->cell[0]->type == LVAL_QEXPR,
-    "First argument to \\ needs to be %s, got: %s", ltype_name(LVAL_QEXPR), ltype_name(v->cell[0]->type));
-  LASSERT(v, v->cell[1]->type == LVAL_QEXPR,
-    "Second argument to \\ needs to be %s, got: %s", ltype_name(LVAL_QEXPR), ltype_name(v->cell[1]->type));
+  LASSERT(v, lval_type(v->cell[0]) == LVAL_QEXPR,
+    "First argument to \\ needs to be %s, got: %s", ltype_name(LVAL_QEXPR), ltype_name(lval_type(v->cell[0])));
+  LASSERT(v, lval_type(v->cell[1]) == LVAL_QEXPR,
+    "Second argument to \\ needs to be %s, got: %s", ltype_name(LVAL_QEXPR), ltype_name(lval_type(v->cell[1])));
 
   lval* formals = lval_pop(v, 0);
   lval* body = lval_pop(v, 0);
   lval_del(v);
 
-  return lval_lambda(formals, body);
+  lval_resolve(body, formals);
+
+  lval* f = lval_lambda(formals, body);
+  f->func->code = lvm_compile(body);
+  return f;
 }
 
 lval* builtin_print(lenv* e, lval* v){
@@ -178,25 +259,34 @@ lval* builtin_print(lenv* e, lval* v){
   return obj;
 }
 
-lval* builtin_if(lenv* e, lval* v){
+lval* builtin_if_branch(lenv* e, lval* v){
   LASSERT(v, v->count == 3,
     "`if` `predicate` then `a` else `b` missing arguments");
 
-  LASSERT(v, v->cell[0]->type == LVAL_BOOL,
-    "`predicate` needs to be of type %s, got: %s", ltype_name(LVAL_BOOL), ltype_name(v->cell[0]->type));
+  LASSERT(v, lval_type(v->cell[0]) == LVAL_BOOL,
+    "`predicate` needs to be of type %s, got: %s", ltype_name(LVAL_BOOL), ltype_name(lval_type(v->cell[0])));
 
   lval* pred = lval_pop(v, 0);
 
   lval* branch;
 
-  if(pred->truth){
+  if(lval_truth(pred)){
     branch = lval_take(v, 0);
   }else{
     branch =  lval_take(v, 1);
   }
 
-  branch->type = LVAL_SEXPR;
-  return lval_eval(e, branch);
+  return lval_retype(branch, LVAL_SEXPR);
+}
+
+lval* builtin_if(lenv* e, lval* v){
+  return lval_eval(e, builtin_if_branch(e, v));
+}
+
+lbuiltin builtin_tail_call(lbuiltin f){
+  if(f == builtin_if){ return builtin_if_branch; }
+  if(f == builtin_eval){ return builtin_eval_expr; }
+  return NULL;
 }
 
 lval* builtin_eq(lenv* e, lval* v){
@@ -206,9 +296,189 @@ lval* builtin_eq(lenv* e, lval* v){
   lval* a = lval_pop(v, 0);
   lval* b = lval_take(v, 0);
 
-  return lval_eq(a, b);
+  lval* result = lval_eq(a, b);
+  lval_del(a); lval_del(b);
+  return result;
 }
 
+// {label value ...} pairs, used by the introspection builtins
+lval* lval_stat(lval* q, char* label, long value){
+  q = lval_add(q, lval_sym(label));
+  return lval_add(q, lval_num(value));
+}
+
+lval* builtin_mem_stats(lenv* e, lval* v){
+  // `(mem-stats)` alone evaluates to the function, so it takes ()
+  LASSERT(v, v->count == 1,
+    "`mem-stats` expects 1 argument, got: %i", v->count);
+  LASSERT(v, lval_type(v->cell[0]) == LVAL_SEXPR && lval_count(v->cell[0]) == 0,
+    "`mem-stats` expects `()`, got: `%s`", ltype_name(lval_type(v->cell[0])));
+  lval_del(v);
+
+  lmem_stats_t stats;
+  lmem_stats(&stats);
+
+  lval* q = lval_qexpr();
+  q = lval_stat(q, "slabs", stats.slabs);
+  q = lval_stat(q, "used", stats.used);
+  q = lval_stat(q, "capacity", stats.capacity);
+  q = lval_stat(q, "bytes", stats.bytes);
+  q = lval_stat(q, "fragmentation", lmem_fragmentation(&stats));
+  q = lval_stat(q, "allocs", stats.allocs);
+  return q;
+}
+
+lval* builtin_symbol_table_stats(lenv* e, lval* v){
+  LASSERT(v, v->count == 1,
+    "`symbol-table-stats` expects 1 argument, got: %i", v->count);
+  LASSERT(v, lval_type(v->cell[0]) == LVAL_SEXPR && lval_count(v->cell[0]) == 0,
+    "`symbol-table-stats` expects `()`, got: `%s`", ltype_name(lval_type(v->cell[0])));
+  lval_del(v);
+
+  lval* q = lval_qexpr();
+  q = lval_stat(q, "symbols", lsym_count());
+  q = lval_stat(q, "bytes", lsym_bytes());
+  return q;
+}
+
+lval* builtin_gc_stats(lenv* e, lval* v){
+  LASSERT(v, v->count == 1,
+    "`gc-stats` expects 1 argument, got: %i", v->count);
+  LASSERT(v, lval_type(v->cell[0]) == LVAL_SEXPR && lval_count(v->cell[0]) == 0,
+    "`gc-stats` expects `()`, got: `%s`", ltype_name(lval_type(v->cell[0])));
+  lval_del(v);
+
+  lgc_stats_t stats;
+  lgc_stats(&stats);
+
+  lval* q = lval_qexpr();
+  q = lval_stat(q, "collections", stats.collections);
+  q = lval_stat(q, "steps", stats.steps);
+  q = lval_stat(q, "reclaimed", stats.reclaimed);
+  q = lval_stat(q, "bytes", stats.reclaimed_bytes);
+  q = lval_stat(q, "budget-us", lgc_budget());
+  q = lval_stat(q, "pause-max-us", stats.pause_max);
+  // pause histogram
+  q = lval_stat(q, "under-10us", stats.pauses[0]);
+  q = lval_stat(q, "under-100us", stats.pauses[1]);
+  q = lval_stat(q, "under-1ms", stats.pauses[2]);
+  q = lval_stat(q, "under-10ms", stats.pauses[3]);
+  q = lval_stat(q, "over-10ms", stats.pauses[4]);
+  return q;
+}
+
+// pause budget for one collector step, in microseconds
+lval* builtin_gc_budget(lenv* e, lval* v){
+  LASSERT(v, v->count == 1,
+    "`gc-budget` expects 1 argument, got: %i", v->count);
+  LASSERT(v, lval_type(v->cell[0]) == LVAL_NUM,
+    "`gc-budget` expects input of type `%s`, got: `%s`", ltype_name(LVAL_NUM), ltype_name(lval_type(v->cell[0])));
+  LASSERT(v, lval_num_value(v->cell[0]) > 0,
+    "`gc-budget` needs a positive number of microseconds");
+
+  lgc_set_budget(lval_num_value(v->cell[0]));
+  lval_del(v);
+  return lval_sexpr();
+}
+
+// frames evaluation may nest before it fails
+lval* builtin_stack_limit(lenv* e, lval* v){
+  LASSERT(v, v->count == 1,
+    "`stack-limit` expects 1 argument, got: %i", v->count);
+  LASSERT(v, lval_type(v->cell[0]) == LVAL_NUM,
+    "`stack-limit` expects input of type `%s`, got: `%s`", ltype_name(LVAL_NUM), ltype_name(lval_type(v->cell[0])));
+  LASSERT(v, lval_num_value(v->cell[0]) > 0,
+    "`stack-limit` needs a positive number of frames");
+
+  lvm_set_depth_limit(lval_num_value(v->cell[0]));
+  lval_del(v);
+  return lval_sexpr();
+}
+
+// runs script files. symbols cannot hold a '.', so `load {lib/prelude}`
+// reads lib/prelude.slip
+lval* builtin_load(lenv* e, lval* v){
+  LASSERT(v, v->count == 1,
+    "`load` expects 1 argument, got: %i", v->count);
+  LASSERT(v, lval_type(v->cell[0]) == LVAL_QEXPR,
+    "`load` expects input of type `%s`, got: `%s`", ltype_name(LVAL_QEXPR), ltype_name(lval_type(v->cell[0])));
+
+  lval* files = v->cell[0];
+  for(int i = 0; i < lval_count(files); i++){
+    LASSERT(v, lval_type(files->cell[i]) == LVAL_SYM,
+      "`load` expects file names as symbols, got: `%s`", ltype_name(lval_type(files->cell[i])));
+  }
+
+  for(int i = 0; i < lval_count(files); i++){
+    lsym* name = files->cell[i]->symbol;
+    char* path = malloc(name->len + sizeof(".slip"));
+    memcpy(path, name->name, name->len);
+    strcpy(path + name->len, ".slip");
+
+    lval* x = lload(e, path, 0);
+    free(path);
+    if(lval_type(x) == LVAL_ERR){
+      lval_del(v);
+      return x;
+    }
+    lval_del(x);
+  }
+
+  lval_del(v);
+  return lval_sexpr();
+}
+
+// `save-image {boot}` writes the whole global scope to boot.slimg, which
+// `slip --image boot.slimg` starts from
+lval* builtin_save_image(lenv* e, lval* v){
+  LASSERT(v, v->count == 1,
+    "`save-image` expects 1 argument, got: %i", v->count);
+  LASSERT(v, lval_type(v->cell[0]) == LVAL_QEXPR && lval_count(v->cell[0]) == 1,
+    "`save-image` expects a file name in a q-expression");
+  LASSERT(v, lval_type(v->cell[0]->cell[0]) == LVAL_SYM,
+    "`save-image` expects the file name as a symbol, got: `%s`", ltype_name(lval_type(v->cell[0]->cell[0])));
+
+  lsym* name = v->cell[0]->cell[0]->symbol;
+  char* path = malloc(name->len + sizeof(".slimg"));
+  memcpy(path, name->name, name->len);
+  strcpy(path + name->len, ".slimg");
+
+  while(e->parent != NULL){ e = e->parent; }
+  lval* x = lload_save_image(e, path);
+  free(path);
+  lval_del(v);
+  return x;
+}
+
+const lbuiltin_name builtin_names[] = {
+  {"list", builtin_list},
+  {"eval", builtin_eval},
+  {"head", builtin_head},
+  {"tail", builtin_tail},
+  {"cons", builtin_cons},
+  {"join", builtin_join},
+  {"def", builtin_def},
+  {"let", builtin_put},
+  {"\\", builtin_lambda},
+  {"print", builtin_print},
+  {"mem-stats", builtin_mem_stats},
+  {"symbol-table-stats", builtin_symbol_table_stats},
+  {"gc-stats", builtin_gc_stats},
+  {"gc-budget", builtin_gc_budget},
+  {"stack-limit", builtin_stack_limit},
+  {"load", builtin_load},
+  {"save-image", builtin_save_image},
+
+  {"if", builtin_if},
+  {"==", builtin_eq},
+
+  {"+", builtin_add},
+  {"-", builtin_sub},
+  {"/", builtin_div},
+  {"*", builtin_mul},
+  {NULL, NULL}
+};
+
 lval* builtin_not(lenv* e, lval* v);
 lval* builtin_greater(lenv* e, lval* v);
 lval* builtin_less(lenv* e, lval* v);
@@ -13,12 +13,17 @@
 
 #define LASSERT_NUM()
 
-lval* builtin_op(lenv* e, lval* a, char* op);
+// an arithmetic kernel folds n numbers, the result is a value or an error
+typedef lval* (*larith)(lval** args, int n);
+// the kernel behind + - * /, NULL for any other builtin
+larith builtin_arith(lbuiltin f);
 
 lval* builtin_head(lenv* e, lval* v);
 lval* builtin_tail(lenv* e, lval* v);
+lval* builtin_cons(lenv* e, lval* v);
 lval* builtin_list(lenv* e, lval* v);
 lval* builtin_eval(lenv* e, lval* v);
+lval* builtin_eval_expr(lenv* e, lval* v);
 lval* builtin_join(lenv* e, lval* qs);
 
 lval* builtin_add(lenv* e, lval* v);
@@ -33,7 +38,17 @@ lval* builtin_lambda(lenv* e, lval* v);
 
 lval* builtin_print(lenv* e, lval* v);
 
+lval* lval_stat(lval* q, char* label, long value);
+lval* builtin_mem_stats(lenv* e, lval* v);
+lval* builtin_symbol_table_stats(lenv* e, lval* v);
+lval* builtin_gc_stats(lenv* e, lval* v);
+lval* builtin_gc_budget(lenv* e, lval* v);
+lval* builtin_stack_limit(lenv* e, lval* v);
+lval* builtin_load(lenv* e, lval* v);
+lval* builtin_save_image(lenv* e, lval* v);
+
 lval* builtin_if(lenv* e, lval* v);
+lval* builtin_if_branch(lenv* e, lval* v);
 lval* builtin_eq(lenv* e, lval* v);
 lval* builtin_not(lenv* e, lval* v);
 lval* builtin_greater(lenv* e, lval* v);
@@ -41,5 +56,20 @@ lval* builtin_less(lenv* e, lval* v);
 lval* builtin_leq(lenv* e, lval* v);
 lval* builtin_geq(lenv* e, lval* v);
 
+// `if` and `eval` end by evaluating an expression in the caller's scope.
+// for those this returns the variant that hands back that expression
+// instead, so lval_eval can evaluate it as a tail call. NULL otherwise.
+lbuiltin builtin_tail_call(lbuiltin f);
+
+// every builtin bound in the global scope, ended by a NULL name. heap
+// images refer to a builtin by its name here, its address changes
+// from one build to the next.
+typedef struct {
+  char* name;
+  lbuiltin func;
+} lbuiltin_name;
+
+extern const lbuiltin_name builtin_names[];
+
 
 #endif
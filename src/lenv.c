@@ -1,71 +1,217 @@
 #include "lenv.h"
+#include "lmem.h"
+
+// per symbol bookkeeping for resolved lookups, indexed by symbol id:
+// how many scopes other than the global one bind the symbol, and the
+// slot it was last found at in the global scope
+typedef struct {
+  int shadow;
+  int global_slot;
+} lenv_symbol;
+
+static lenv_symbol* symbols = NULL;
+static int symbols_size = 0;
+
+static lenv* global_scope = NULL;
+
+static lenv_symbol* lenv_symbol_of(lsym* s){
+  if(s->id >= symbols_size){
+    int size = symbols_size == 0 ? 256 : symbols_size;
+    while(size <= s->id){ size *= 2; }
+    symbols = realloc(symbols, sizeof(lenv_symbol) * size);
+    for(int i = symbols_size; i < size; i++){
+      symbols[i].shadow = 0;
+      symbols[i].global_slot = -1;
+    }
+    symbols_size = size;
+  }
+  return &symbols[s->id];
+}
 
 // Environments
 lenv*  lenv_new(void){
-  lenv* e = malloc(sizeof(lenv));
+  lenv* e = lmem_alloc(sizeof(lenv));
   e->parent = NULL;
+  e->global = 0;
   e->count = 0;
+  e->capacity = 0;
   e->symbols = NULL;
   e->values = NULL;
+  e->index = NULL;
+  e->index_size = 0;
   return e;
 }
 
+lenv*  lenv_new_global(void){
+  lenv* e = lenv_new();
+  e->global = 1;
+  global_scope = e;
+  return e;
+}
+
+lenv* lenv_global(void){
+  return global_scope;
+}
+
 void lenv_del(lenv* e){
   for(int i = 0; i < e->count; i++){
-    free(e->symbols[i]);
     lval_del(e->values[i]);
   }
+  lenv_release(e);
+}
+
+long lenv_release(lenv* e){
+  long bytes = sizeof(lenv) + e->capacity * (sizeof(lsym*) + sizeof(lval*));
+  bytes += e->index_size * sizeof(int);
+
+  if(!e->global){
+    for(int i = 0; i < e->count; i++){
+      lenv_symbol_of(e->symbols[i])->shadow--;
+    }
+  }
+  if(e == global_scope){ global_scope = NULL; }
   free(e->symbols);
   free(e->values);
-  free(e);
+  free(e->index);
+  lmem_free(e, sizeof(lenv));
+  return bytes;
 }
 
 lenv* lenv_copy(lenv* e){
-  lenv* new = malloc(sizeof(lenv));
+  lenv* new = lmem_alloc(sizeof(lenv));
   new->parent = e->parent;
+  new->global = 0;
   new->count = e->count;
-  new->symbols = malloc(sizeof(char*) * new->count);
-  new->values = malloc(sizeof(lval) * new->count);
+  new->capacity = e->count;
+  new->symbols = malloc(sizeof(lsym*) * new->count);
+  new->values = malloc(sizeof(lval*) * new->count);
   for(int i = 0; i < new->count; i++){
-    new->symbols[i] = malloc(strlen(e->symbols[i]) + 1);
-    strcpy(new->symbols[i], e->symbols[i]);
+    new->symbols[i] = e->symbols[i];
+    lenv_symbol_of(e->symbols[i])->shadow++;
     new->values[i] = lval_copy(e->values[i]);
   }
 
+  new->index_size = e->index_size;
+  new->index = NULL;
+  if(e->index != NULL){
+    new->index = malloc(sizeof(int) * e->index_size);
+    memcpy(new->index, e->index, sizeof(int) * e->index_size);
+  }
+
   return new;
 }
 
-lval* lenv_get(lenv* e, lval* symbol){
+// the index maps a symbol's hash to its slot, stored as slot + 1 so that
+// zeroed memory reads as empty
+static void lenv_index_insert(lenv* e, int slot){
+  int mask = e->index_size - 1;
+  int i = e->symbols[slot]->hash & mask;
+  while(e->index[i] != 0){ i = (i + 1) & mask; }
+  e->index[i] = slot + 1;
+}
+
+static void lenv_index_rebuild(lenv* e, int size){
+  free(e->index);
+  e->index = calloc(size, sizeof(int));
+  e->index_size = size;
   for(int i = 0; i < e->count; i++){
-    if(strcmp(e->symbols[i], symbol->symbol) == 0){
-      return lval_copy(e->values[i]);
+    lenv_index_insert(e, i);
+  }
+}
+
+int lenv_find(lenv* e, lsym* symbol){
+  if(e->index == NULL){
+    // small frames stay a plain array, a scan is cheaper than hashing
+    for(int i = 0; i < e->count; i++){
+      if(e->symbols[i] == symbol){ return i; }
+    }
+    return -1;
+  }
+
+  int mask = e->index_size - 1;
+  int i = symbol->hash & mask;
+  while(e->index[i] != 0){
+    int slot = e->index[i] - 1;
+    if(e->symbols[slot] == symbol){ return slot; }
+    i = (i + 1) & mask;
+  }
+  return -1;
+}
+
+lval* lenv_get(lenv* e, lval* symbol){
+  lsym* sym = symbol->symbol;
+  int slot = symbol->addr;
+
+  // formal of the running lambda, resolved by lval_resolve
+  if(slot >= 0 && slot < e->count && e->symbols[slot] == sym){
+    return lval_copy(e->values[slot]);
+  }
+
+  // when no other scope binds the name the lookup has to end in the
+  // global scope, so go there directly through the cached slot
+  if(slot == LVAL_ADDR_GLOBAL && global_scope != NULL){
+    lenv_symbol* s = lenv_symbol_of(sym);
+    if(s->shadow == 0){
+      slot = s->global_slot;
+      if(slot < 0 || slot >= global_scope->count || global_scope->symbols[slot] != sym){
+        slot = s->global_slot = lenv_find(global_scope, sym);
+      }
+      if(slot >= 0){ return lval_copy(global_scope->values[slot]); }
+      return lval_err("unbound symbol");
     }
   }
 
   // if symbol is not found in the local scope, check in the parent scope
-  if(e->parent != NULL){
-    return lenv_get(e->parent, symbol);
+  for(; e != NULL; e = e->parent){
+    slot = lenv_find(e, sym);
+    if(slot >= 0){
+      return lval_copy(e->values[slot]);
+    }
   }
 
   return lval_err("unbound symbol");
 }
 
-void lenv_put(lenv* e, lval* symbol, lval* value){
-  for(int i = 0; i < e->count; i++){
-    if(strcmp(e->symbols[i], symbol->symbol) == 0){
-      lval_del(e->values[i]);
-      e->values[i] = lval_copy(value);
-      return;
-    }
+static void lenv_put_sym(lenv* e, lsym* symbol, lval* value){
+  int slot = lenv_find(e, symbol);
+  if(slot >= 0){
+    lval_del(e->values[slot]);
+    e->values[slot] = lval_copy(value);
+    return;
   }
 
-  e->count++;
-  e->symbols = realloc(e->symbols, sizeof(lval*) * e->count);
-  e->values = realloc(e->values, sizeof(char*) * e->count);
+  if(e->count == e->capacity){
+    e->capacity = e->capacity == 0 ? 4 : e->capacity * 2;
+    e->symbols = realloc(e->symbols, sizeof(lsym*) * e->capacity);
+    e->values = realloc(e->values, sizeof(lval*) * e->capacity);
+  }
 
+  e->count++;
   e->values[e->count - 1] = lval_copy(value);
-  e->symbols[e->count - 1] = malloc(strlen(symbol->symbol) + 1);
-  strcpy(e->symbols[e->count - 1], symbol->symbol);
+  e->symbols[e->count - 1] = symbol;
+  if(!e->global){ lenv_symbol_of(symbol)->shadow++; }
+
+  // keep the index at most half full
+  if(e->index != NULL && e->count * 2 > e->index_size){
+    lenv_index_rebuild(e, e->index_size * 2);
+  }else if(e->index != NULL){
+    lenv_index_insert(e, e->count - 1);
+  }else if(e->count > LENV_INLINE){
+    lenv_index_rebuild(e, LENV_INLINE * 4);
+  }
+}
+
+void lenv_put(lenv* e, lval* symbol, lval* value){
+  lenv_put_sym(e, symbol->symbol, value);
+}
+
+void lenv_merge(lenv* e, lenv* from){
+  for(int i = 0; i < from->count; i++){
+    if(lenv_find(e, from->symbols[i]) < 0){
+      lenv_put_sym(e, from->symbols[i], from->values[i]);
+    }
+  }
+  e->parent = from->parent;
 }
 
 void lenv_def(lenv* e, lval* symbol, lval* value){
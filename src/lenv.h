@@ -3,22 +3,43 @@
 
 #include "lval.h"
 
+// frames with up to this many bindings are searched linearly,
+// bigger scopes (the global scope, closures) get a hash index
+#define LENV_INLINE 8
+
 struct lenv{
   lenv* parent;
+  int global;
   int count;
+  int capacity;
   lval** values;
-  char** symbols;
+  lsym** symbols;
+
+  // open addressing index over the slots, NULL for small frames
+  int* index;
+  int index_size;
 };
 
 // Environments
 lenv*  lenv_new(void);
+// the root scope every evaluation ends up in, there is one per process
+lenv*  lenv_new_global(void);
+// that scope, NULL before it is made
+lenv*  lenv_global(void);
 void lenv_del(lenv* e);
+// free the scope but not the values bound in it, returns the bytes freed
+long lenv_release(lenv* e);
 lenv* lenv_copy(lenv* e);
 lval* lenv_get(lenv* e, lval* symbol);
+// slot of a symbol bound directly in e, -1 if it is not bound there
+int lenv_find(lenv* e, lsym* symbol);
 
 // define in function scope
 void lenv_put(lenv* e, lval* symbol, lval* value);
 // define in global
 void lenv_def(lenv* e, lval* symbol, lval* value);
+// let e take from's place in the chain: e gets every binding of from
+// that it does not shadow, and from's parent
+void lenv_merge(lenv* e, lenv* from);
 
 #endif
@@ -0,0 +1,181 @@
+#define _POSIX_C_SOURCE 199309L
+#include <time.h>
+
+#include "lgc.h"
+#include "lenv.h"
+#include "lmem.h"
+#include "lvm.h"
+
+// start a cycle once this many values were allocated since the last one,
+// or as many as survived the last cycle if that is more
+#define LGC_MIN_THRESHOLD 65536
+
+int lgc_phase = LGC_IDLE;
+unsigned int lgc_black = 1;
+
+static lval** grey = NULL;
+static int grey_count = 0;
+static int grey_size = 0;
+
+// the root scope is scanned incrementally like any other value
+static lenv* root_scope = NULL;
+static int root_next = 0;
+
+static lmem_cursor cursor;
+static long survivors = 0;
+
+static long budget = 1000;
+long lgc_debt = 0;
+long lgc_threshold = LGC_MIN_THRESHOLD;
+
+static lgc_stats_t stats;
+
+void lgc_shade(lval* v){
+  if(!lval_is_heap(v) || v->mark == lgc_black){ return; }
+  v->mark = lgc_black;
+
+  if(grey_count == grey_size){
+    grey_size = grey_size == 0 ? 1024 : grey_size * 2;
+    grey = realloc(grey, sizeof(lval*) * grey_size);
+  }
+  grey[grey_count++] = v;
+}
+
+static void lgc_shade_scope(lenv* e){
+  for(int i = 0; i < e->count; i++){
+    lgc_shade(e->values[i]);
+  }
+}
+
+static void lgc_trace(lval* v){
+  // the value may have been freed by its count since it was shaded
+  if(!lmem_is_allocated(v)){ return; }
+
+  switch(v->type){
+    case LVAL_SEXPR:
+    case LVAL_QEXPR:
+      // a view's cells are traced through its base
+      if(v->view){
+        lgc_shade(((lval_view*)v)->base);
+        break;
+      }
+      for(int i = 0; i < v->count; i++){
+        lgc_shade(v->cell[i]);
+      }
+      break;
+    case LVAL_FUNC:
+      if(!lval_is_builtin(v)){
+        lgc_shade(v->func->formals);
+        lgc_shade(v->func->body);
+        lgc_shade_scope(v->func->func_scope);
+        if(v->func->code != NULL){
+          for(int i = 0; i < v->func->code->nconsts; i++){
+            lgc_shade(v->func->code->consts[i]);
+          }
+        }
+      }
+      break;
+  }
+}
+
+void lgc_allocated(void){
+  lgc_debt++;
+}
+
+static long lgc_now(void){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000L + t.tv_nsec / 1000;
+}
+
+static void lgc_begin(lenv* root){
+  // flipping the meaning of the mark bit makes every value white
+  lgc_black ^= 1;
+  lgc_phase = LGC_MARK;
+  root_scope = root;
+  root_next = 0;
+  survivors = 0;
+  lgc_debt = 0;
+  // holding the cursor also keeps slabs mapped while grey values point in
+  lmem_cursor_begin(&cursor, LMEM_TRACED);
+  lvm_shade_roots();
+}
+
+static void lgc_finish(void){
+  lmem_cursor_end(&cursor);
+  lgc_phase = LGC_IDLE;
+  root_scope = NULL;
+  lgc_threshold = survivors > LGC_MIN_THRESHOLD ? survivors : LGC_MIN_THRESHOLD;
+  stats.collections++;
+}
+
+// one unit of work, returns 0 once the cycle is complete
+static int lgc_work(void){
+  if(lgc_phase == LGC_MARK){
+    if(root_scope != NULL && root_next < root_scope->count){
+      lgc_shade(root_scope->values[root_next++]);
+      return 1;
+    }
+    if(grey_count > 0){
+      lgc_trace(grey[--grey_count]);
+      return 1;
+    }
+    // nothing guards stores into the stack or frame scopes, look again
+    lvm_shade_roots();
+    if(grey_count > 0){ return 1; }
+    lgc_phase = LGC_SWEEP;
+    return 1;
+  }
+
+  lval* v = lmem_cursor_next(&cursor);
+  if(v == NULL){
+    lgc_finish();
+    return 0;
+  }
+
+  if(v->mark == lgc_black){
+    survivors++;
+  }else{
+    stats.reclaimed++;
+    stats.reclaimed_bytes += lval_reclaim(v);
+  }
+  return 1;
+}
+
+void lgc_safepoint(lenv* root){
+  if(lgc_phase == LGC_IDLE){
+    if(lgc_debt < lgc_threshold){ return; }
+    lgc_begin(root);
+  }
+
+  long start = lgc_now();
+  long elapsed = 0;
+  for(int n = 1; lgc_work(); n++){
+    // the clock is not free, only look at it every so often
+    if(n % 128 == 0){
+      elapsed = lgc_now() - start;
+      if(elapsed >= budget){ break; }
+    }
+  }
+  elapsed = lgc_now() - start;
+
+  stats.steps++;
+  if(elapsed > stats.pause_max){ stats.pause_max = elapsed; }
+  int bucket = 0;
+  for(long limit = 10; bucket < LGC_BUCKETS - 1 && elapsed >= limit; limit *= 10){
+    bucket++;
+  }
+  stats.pauses[bucket]++;
+}
+
+void lgc_set_budget(long usec){
+  budget = usec > 0 ? usec : 1;
+}
+
+long lgc_budget(void){
+  return budget;
+}
+
+void lgc_stats(lgc_stats_t* out){
+  *out = stats;
+}
@@ -0,0 +1,74 @@
+#ifndef lgc_h
+#define lgc_h
+
+#include "lval.h"
+
+// incremental mark and sweep collector
+// ------------------------------------
+// reference counts free almost everything as soon as it dies. the
+// collector is the backstop for what they miss: values whose count got
+// stuck at LVAL_REFS_MAX and anything a reference was leaked to.
+//
+// it traces from the global scope and the evaluator's frames and operand
+// stack in small steps, each bounded by the pause budget, at safe points:
+// between top-level forms and at calls in the outermost run. between steps a write barrier (lgc_write) shades every value
+// stored into a list or a scope, so the mutator never hides a live
+// value behind one that was already traced.
+
+enum {
+  LGC_IDLE,
+  LGC_MARK,
+  LGC_SWEEP
+};
+
+// phase and the mark value that means "reached" in the current cycle
+extern int lgc_phase;
+extern unsigned int lgc_black;
+
+void lgc_shade(lval* v);
+
+static inline void lgc_write(lval* v){
+  if(lgc_phase == LGC_MARK){ lgc_shade(v); }
+}
+
+// new values are born marked, they are never swept by a running cycle
+static inline unsigned int lgc_alloc_mark(void){
+  return lgc_black;
+}
+
+// count a new heap value towards the next collection
+void lgc_allocated(void);
+
+// values allocated since the last cycle, and how many start the next one
+extern long lgc_debt;
+extern long lgc_threshold;
+
+// whether lgc_safepoint has anything to do, cheap enough for every call
+static inline int lgc_pending(void){
+  return lgc_phase != LGC_IDLE || lgc_debt >= lgc_threshold;
+}
+
+// run a bounded amount of collection if one is due or in progress.
+// only call this where every live value is reachable from the root or
+// the evaluator's stacks.
+void lgc_safepoint(lenv* root);
+
+// pause budget for one step, in microseconds
+void lgc_set_budget(long usec);
+long lgc_budget(void);
+
+// pause histogram buckets: <10us, <100us, <1ms, <10ms, longer
+#define LGC_BUCKETS 5
+
+typedef struct {
+  long collections;
+  long steps;
+  long reclaimed;         // values freed by the collector
+  long reclaimed_bytes;
+  long pause_max;         // longest step, microseconds
+  long pauses[LGC_BUCKETS];
+} lgc_stats_t;
+
+void lgc_stats(lgc_stats_t* stats);
+
+#endif
@@ -0,0 +1,172 @@
+#define _POSIX_C_SOURCE 200112L
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lload.h"
+#include "lread.h"
+#include "lslipc.h"
+#include "lgc.h"
+
+// maps the whole file read-only. an empty file cannot be mapped, and has
+// nothing to read anyway, so it comes back as NULL and 0.
+static lval* lload_map(const char* path, char** src, size_t* len){
+  *src = NULL;
+  *len = 0;
+
+  int fd = open(path, O_RDONLY);
+  if(fd < 0){
+    return lval_err("cannot load %s: %s", path, strerror(errno));
+  }
+
+  struct stat st;
+  if(fstat(fd, &st) != 0){
+    lval* err = lval_err("cannot load %s: %s", path, strerror(errno));
+    close(fd);
+    return err;
+  }
+
+  if(st.st_size > 0){
+    char* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(p == MAP_FAILED){
+      lval* err = lval_err("cannot load %s: %s", path, strerror(errno));
+      close(fd);
+      return err;
+    }
+    *src = p;
+    *len = (size_t)st.st_size;
+  }
+  close(fd);
+  return NULL;
+}
+
+static char* lload_image_path(const char* path){
+  size_t n = strlen(path);
+  char* image = malloc(n + 2);
+  memcpy(image, path, n);
+  image[n] = 'c';
+  image[n + 1] = '\0';
+  return image;
+}
+
+// written next to path and renamed over, so a reader never sees half a file
+static lval* lload_write(const char* path, const char* data, size_t size){
+  lval* err = NULL;
+  char* tmp = malloc(strlen(path) + 5);
+  sprintf(tmp, "%s.tmp", path);
+
+  FILE* f = fopen(tmp, "wb");
+  int ok = f != NULL && fwrite(data, 1, size, f) == size;
+  if(f != NULL && fclose(f) != 0){ ok = 0; }
+  if(ok && rename(tmp, path) != 0){ ok = 0; }
+  if(!ok){
+    err = lval_err("cannot write %s: %s", path, strerror(errno));
+    remove(tmp);
+  }
+
+  free(tmp);
+  return err != NULL ? err : lval_sexpr();
+}
+
+lval* lload_compile(const char* path){
+  char* src;
+  size_t len;
+  lval* err = lload_map(path, &src, &len);
+  if(err != NULL){ return err; }
+
+  size_t size;
+  char* data = lslipc_compile(path, src, len, &size, &err);
+  if(len > 0){ munmap(src, len); }
+  if(data == NULL){ return err; }
+
+  char* image = lload_image_path(path);
+  lval* x = lload_write(image, data, size);
+  free(image);
+  free(data);
+  return x;
+}
+
+lval* lload_save_image(lenv* e, const char* path){
+  size_t size;
+  lval* err;
+  char* data = lslimg_save(e, &size, &err);
+  if(data == NULL){ return err; }
+
+  lval* x = lload_write(path, data, size);
+  free(data);
+  return x;
+}
+
+lval* lload_image(lenv* e, const char* path){
+  char* data;
+  size_t size;
+  lval* err = lload_map(path, &data, &size);
+  if(err != NULL){ return err; }
+
+  lval* x = lslimg_restore(e, path, data, size);
+  if(size > 0){ munmap(data, size); }
+  return x;
+}
+
+lval* lload(lenv* e, const char* path, int collect){
+  char* src;
+  size_t len;
+  lval* err = lload_map(path, &src, &len);
+  if(err != NULL){ return err; }
+
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  // start of the pages still mapped
+  size_t mapped = 0;
+
+  lreader r;
+  lreader_init(&r, path, src, len);
+
+  // an up to date image replaces reading the source
+  char* image_path = lload_image_path(path);
+  char* data = NULL;
+  size_t size = 0;
+  lslipc image;
+  int compiled = 0;
+  err = lload_map(image_path, &data, &size);
+  if(err != NULL){
+    lval_del(err);
+  }else if(lslipc_open(&image, image_path, data, size, src, len)){
+    compiled = 1;
+    // the source was only needed for its hash
+    if(len > 0){ munmap(src, len); }
+    mapped = len;
+  }
+
+  lval* result = lval_sexpr();
+  lval* x;
+  while((x = compiled ? lslipc_next(&image) : lread_next(&r)) != NULL){
+    if(compiled ? image.failed : r.failed){
+      lval_del(result);
+      result = x;
+      break;
+    }
+
+    x = lval_eval(e, x);
+    if(lval_type(x) == LVAL_ERR){ lval_println(x); }
+    lval_del(x);
+
+    if(collect){ lgc_safepoint(e); }
+
+    // whatever was read from the mapping has been copied or interned.
+    // the reader never moves when the image is used, and the source is
+    // gone then already
+    size_t done = r.pos / page * page;
+    if(done > mapped && done - mapped >= LLOAD_RELEASE){
+      munmap(src + mapped, done - mapped);
+      mapped = done;
+    }
+  }
+
+  if(compiled){ lslipc_close(&image); }
+  free(image_path);
+  if(size > 0){ munmap(data, size); }
+  if(len > mapped){ munmap(src + mapped, len - mapped); }
+  return result;
+}
@@ -0,0 +1,37 @@
+#ifndef lload_h
+#define lload_h
+
+#include "lval.h"
+
+// script files
+// ------------
+// a file is mapped into memory and read straight out of the mapping, one
+// top-level expression at a time. each is evaluated before the next one
+// is read, so memory grows with the largest expression and not with the
+// file. pages already read are unmapped as the reader moves on.
+//
+// when `file.slipc` next to `file.slip` is an image of exactly that
+// source (see lslipc.h), the expressions are built from it instead.
+
+// unmap the pages behind the reader once this many bytes were read
+#define LLOAD_RELEASE (1024 * 1024)
+
+// evaluates every expression in the file at path in e, printing the
+// ones that fail. returns () or the error that stopped the load, a
+// syntax error or a file that cannot be read. collect runs the
+// collector between expressions, only for e with nothing else live.
+lval* lload(lenv* e, const char* path, int collect);
+
+// reads the file at path and writes its image to path with a `c` added.
+// returns () or why it could not.
+lval* lload_compile(const char* path);
+
+// writes the global scope e to a heap image at path, see lslipc.h.
+// returns () or why it could not.
+lval* lload_save_image(lenv* e, const char* path);
+// binds everything saved in the heap image at path in the global scope
+// e. the file is mapped read-only, names are interned and values built
+// straight out of the mapping and nothing is evaluated.
+lval* lload_image(lenv* e, const char* path);
+
+#endif
@@ -0,0 +1,238 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "lmem.h"
+
+typedef struct lmem_block lmem_block;
+struct lmem_block {
+  lmem_block* next;
+};
+
+#define LMEM_MAP_WORDS ((LMEM_SLAB_SIZE / LMEM_MIN_BLOCK + 63) / 64)
+
+// slab header, lives at the start of every aligned slab
+struct lmem_slab {
+  // partial list: slabs of the same class and kind with free blocks
+  lmem_slab* prev;
+  lmem_slab* next;
+  // every slab of the kind, used to walk the allocated blocks
+  lmem_slab* all_prev;
+  lmem_slab* all_next;
+  lmem_block* free;
+  char* bump;     // start of the never used tail of the slab
+  int cls;
+  int kind;
+  int used;
+  int capacity;
+  // one bit per block, set while the block is allocated
+  uint64_t map[LMEM_MAP_WORDS];
+};
+
+// per thread heap: for each kind and size class the slabs that still
+// have room, and for each kind the list of all its slabs
+typedef struct {
+  lmem_slab* partial[LMEM_KINDS][LMEM_CLASSES];
+  lmem_slab* all[LMEM_KINDS];
+  // while a cursor walks a kind its empty slabs are kept
+  int walking[LMEM_KINDS];
+  lmem_stats_t stats;
+} lmem_heap;
+
+static __thread lmem_heap heap;
+
+// keep the first block on a cache line boundary
+#define LMEM_HEADER_SIZE (((sizeof(lmem_slab) + 63) / 64) * 64)
+
+static int lmem_class(size_t size){
+  int cls = 0;
+  size_t block = LMEM_MIN_BLOCK;
+  while(block < size){ block <<= 1; cls++; }
+  return cls;
+}
+
+static size_t lmem_class_size(int cls){
+  return (size_t)LMEM_MIN_BLOCK << cls;
+}
+
+static lmem_slab* lmem_slab_of(void* p){
+  return (lmem_slab*)((uintptr_t)p & ~(uintptr_t)(LMEM_SLAB_SIZE - 1));
+}
+
+static int lmem_block_index(lmem_slab* s, void* p){
+  return (int)(((char*)p - ((char*)s + LMEM_HEADER_SIZE)) / lmem_class_size(s->cls));
+}
+
+// blocks below the bump pointer, every one of them was handed out once
+static int lmem_touched(lmem_slab* s){
+  return (int)((s->bump - ((char*)s + LMEM_HEADER_SIZE)) / lmem_class_size(s->cls));
+}
+
+static void lmem_unlink(lmem_slab* s){
+  if(s->prev != NULL){ s->prev->next = s->next; }
+  else{ heap.partial[s->kind][s->cls] = s->next; }
+  if(s->next != NULL){ s->next->prev = s->prev; }
+  s->prev = s->next = NULL;
+}
+
+static void lmem_link(lmem_slab* s){
+  s->prev = NULL;
+  s->next = heap.partial[s->kind][s->cls];
+  if(s->next != NULL){ s->next->prev = s; }
+  heap.partial[s->kind][s->cls] = s;
+}
+
+static lmem_slab* lmem_slab_new(int cls, int kind){
+  void* mem = NULL;
+  if(posix_memalign(&mem, LMEM_SLAB_SIZE, LMEM_SLAB_SIZE) != 0){ return NULL; }
+
+  lmem_slab* s = mem;
+  s->prev = s->next = NULL;
+  s->free = NULL;
+  s->bump = (char*)s + LMEM_HEADER_SIZE;
+  s->cls = cls;
+  s->kind = kind;
+  s->used = 0;
+  s->capacity = (LMEM_SLAB_SIZE - LMEM_HEADER_SIZE) / lmem_class_size(cls);
+  for(int i = 0; i < LMEM_MAP_WORDS; i++){ s->map[i] = 0; }
+
+  s->all_prev = NULL;
+  s->all_next = heap.all[kind];
+  if(s->all_next != NULL){ s->all_next->all_prev = s; }
+  heap.all[kind] = s;
+
+  heap.stats.slabs++;
+  heap.stats.capacity += s->capacity;
+  heap.stats.bytes += LMEM_SLAB_SIZE;
+  lmem_link(s);
+  return s;
+}
+
+static void lmem_slab_del(lmem_slab* s){
+  lmem_unlink(s);
+  if(s->all_prev != NULL){ s->all_prev->all_next = s->all_next; }
+  else{ heap.all[s->kind] = s->all_next; }
+  if(s->all_next != NULL){ s->all_next->all_prev = s->all_prev; }
+
+  heap.stats.slabs--;
+  heap.stats.capacity -= s->capacity;
+  heap.stats.bytes -= LMEM_SLAB_SIZE;
+  free(s);
+}
+
+void* lmem_alloc_kind(size_t size, int kind){
+  if(size > LMEM_MAX_BLOCK){ return malloc(size); }
+
+  int cls = lmem_class(size);
+  lmem_slab* s = heap.partial[kind][cls];
+  if(s == NULL){
+    s = lmem_slab_new(cls, kind);
+    if(s == NULL){ return NULL; }
+  }
+
+  void* p;
+  if(s->free != NULL){
+    p = s->free;
+    s->free = s->free->next;
+  }else{
+    p = s->bump;
+    s->bump += lmem_class_size(cls);
+  }
+
+  int i = lmem_block_index(s, p);
+  s->map[i / 64] |= (uint64_t)1 << (i % 64);
+
+  s->used++;
+  heap.stats.used++;
+  heap.stats.allocs++;
+  // full slabs leave the partial list until a block comes back
+  if(s->used == s->capacity){ lmem_unlink(s); }
+  return p;
+}
+
+void* lmem_alloc(size_t size){
+  return lmem_alloc_kind(size, LMEM_PLAIN);
+}
+
+void lmem_free(void* p, size_t size){
+  if(p == NULL){ return; }
+  if(size > LMEM_MAX_BLOCK){ free(p); return; }
+
+  lmem_slab* s = lmem_slab_of(p);
+  int i = lmem_block_index(s, p);
+  s->map[i / 64] &= ~((uint64_t)1 << (i % 64));
+
+  lmem_block* b = p;
+  b->next = s->free;
+  s->free = b;
+
+  if(s->used == s->capacity){ lmem_link(s); }
+  s->used--;
+  heap.stats.used--;
+
+  // hand empty slabs back, unless it is the only one left for its class
+  if(s->used == 0 && !heap.walking[s->kind] && (s->prev != NULL || s->next != NULL)){
+    lmem_slab_del(s);
+  }
+}
+
+int lmem_is_allocated(void* p){
+  lmem_slab* s = lmem_slab_of(p);
+  int i = lmem_block_index(s, p);
+  return (s->map[i / 64] >> (i % 64)) & 1;
+}
+
+void lmem_cursor_begin(lmem_cursor* c, int kind){
+  heap.walking[kind]++;
+  c->kind = kind;
+  c->slab = heap.all[kind];
+  c->index = 0;
+}
+
+void* lmem_cursor_next(lmem_cursor* c){
+  while(c->slab != NULL){
+    lmem_slab* s = c->slab;
+    int end = lmem_touched(s);
+
+    while(c->index < end){
+      int i = c->index++;
+      if((s->map[i / 64] >> (i % 64)) & 1){
+        return (char*)s + LMEM_HEADER_SIZE + i * lmem_class_size(s->cls);
+      }
+    }
+
+    c->slab = s->all_next;
+    c->index = 0;
+  }
+  return NULL;
+}
+
+void lmem_cursor_end(lmem_cursor* c){
+  if(--heap.walking[c->kind] > 0){ return; }
+
+  // release whatever emptied out during the walk
+  lmem_slab* s = heap.all[c->kind];
+  while(s != NULL){
+    lmem_slab* next = s->all_next;
+    if(s->used == 0 && (s->prev != NULL || s->next != NULL)){
+      lmem_slab_del(s);
+    }
+    s = next;
+  }
+}
+
+void lmem_stats(lmem_stats_t* stats){
+  *stats = heap.stats;
+  // a slab with any block in use keeps every block it freed
+  stats->holes = 0;
+  for(int k = 0; k < LMEM_KINDS; k++){
+    for(lmem_slab* s = heap.all[k]; s != NULL; s = s->all_next){
+      if(s->used > 0){ stats->holes += lmem_touched(s) - s->used; }
+    }
+  }
+}
+
+int lmem_fragmentation(lmem_stats_t* stats){
+  if(stats->capacity == 0){ return 0; }
+  return (int)((stats->holes * 100) / stats->capacity);
+}
@@ -0,0 +1,61 @@
+#ifndef lmem_h
+#define lmem_h
+
+#include <stddef.h>
+
+// slab allocator for the interpreter's small fixed-size objects
+// -------------------------------------------------------------
+// blocks are carved out of 64KiB aligned slabs, one slab per size class.
+// every thread owns its own slabs and free lists, so blocks have to be
+// freed on the thread that allocated them.
+
+#define LMEM_SLAB_SIZE (64 * 1024)
+#define LMEM_CLASSES 5
+// size classes are powers of two from 16 to 256 bytes, so no block
+// smaller than a cache line ever straddles two lines
+#define LMEM_MIN_BLOCK 16
+#define LMEM_MAX_BLOCK 256
+
+// slabs are kept apart by kind, so a walk over the blocks of one kind
+// (the collector sweeping values) never sees anything else
+enum {
+  LMEM_PLAIN,
+  LMEM_TRACED,
+  LMEM_KINDS
+};
+
+typedef struct {
+  long slabs;     // slabs currently held
+  long used;      // blocks handed out
+  long capacity;  // blocks the live slabs can hold
+  long bytes;     // bytes of slab memory held
+  long allocs;    // blocks handed out since the start
+  long holes;     // freed blocks in slabs that still have some in use
+} lmem_stats_t;
+
+typedef struct lmem_slab lmem_slab;
+
+// walks the allocated blocks of a kind. blocks freed during the walk are
+// fine, blocks allocated during the walk may or may not be visited.
+typedef struct {
+  int kind;
+  lmem_slab* slab;
+  int index;
+} lmem_cursor;
+
+void* lmem_alloc(size_t size);
+void* lmem_alloc_kind(size_t size, int kind);
+void lmem_free(void* p, size_t size);
+int lmem_is_allocated(void* p);
+
+void lmem_cursor_begin(lmem_cursor* c, int kind);
+void* lmem_cursor_next(lmem_cursor* c);
+void lmem_cursor_end(lmem_cursor* c);
+
+// totals for the calling thread
+void lmem_stats(lmem_stats_t* stats);
+// percentage of slab capacity lost to holes: blocks that were freed but
+// stay held because other blocks of their slab are still in use
+int lmem_fragmentation(lmem_stats_t* stats);
+
+#endif
@@ -0,0 +1,216 @@
+#include "lread.h"
+
+// a list still waiting for its closing bracket
+typedef struct {
+  lval* parent;
+  char close;
+  int line;
+  int col;
+} lopen;
+
+// lists nested deeper than this go on the heap
+#define LREAD_STACK 16
+
+static int lread_space(char c){
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static int lread_digit(char c){
+  return c >= '0' && c <= '9';
+}
+
+static int lread_symbol_char(char c){
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || lread_digit(c) ||
+    (c != '\0' && strchr("[_+-*/\\=<>!&", c) != NULL);
+}
+
+static int lread_at(lreader* r, const char* word){
+  size_t n = strlen(word);
+  return r->len - r->pos >= n && memcmp(r->src + r->pos, word, n) == 0;
+}
+
+// tokens never span lines, only whitespace moves to the next one
+static void lread_skip_space(lreader* r){
+  while(r->pos < r->len && lread_space(r->src[r->pos])){
+    if(r->src[r->pos] == '\n'){
+      r->line++;
+      r->col = 1;
+    }else{
+      r->col++;
+    }
+    r->pos++;
+  }
+}
+
+static lval* lread_error(lreader* r, char* what){
+  return lval_err("%s:%i:%i: error: %s", r->name, r->line, r->col, what);
+}
+
+static lval* lread_number(lreader* r){
+  const char* start = r->src + r->pos;
+  size_t n = 0;
+  int negative = start[0] == '-';
+  if(negative){ n++; }
+
+  long x = 0;
+  int overflow = 0;
+  while(r->pos + n < r->len && lread_digit(start[n])){
+    int d = start[n] - '0';
+    overflow |= __builtin_mul_overflow(x, 10, &x);
+    overflow |= negative ? __builtin_sub_overflow(x, d, &x) : __builtin_add_overflow(x, d, &x);
+    n++;
+  }
+
+  r->pos += n;
+  r->col += n;
+  return overflow ? lval_err("invalid number %.*s", (int)n, start) : lval_num(x);
+}
+
+static lval* lread_symbol(lreader* r){
+  const char* start = r->src + r->pos;
+  size_t n = 0;
+  while(r->pos + n < r->len && lread_symbol_char(start[n])){ n++; }
+
+  r->pos += n;
+  r->col += n;
+  // symbols are interned as they are read
+  return lval_sym_interned(lsym_intern_n(start, n));
+}
+
+void lreader_init(lreader* r, const char* name, const char* src, size_t len){
+  r->name = name;
+  r->src = src;
+  r->len = len;
+  r->pos = 0;
+  r->line = 1;
+  r->col = 1;
+  r->failed = 0;
+}
+
+lval* lread_next(lreader* r){
+  lopen stack[LREAD_STACK];
+  lopen* open = stack;
+  int size = LREAD_STACK;
+  int depth = 0;
+
+  // the list being read, NULL outside of any brackets
+  lval* x = NULL;
+  lval* err = NULL;
+
+  while(1){
+    lread_skip_space(r);
+    if(r->pos == r->len){
+      if(depth > 0){
+        char what[64];
+        snprintf(what, sizeof(what), "expected '%c' at end of input, to close the list at %i:%i",
+          open[depth - 1].close, open[depth - 1].line, open[depth - 1].col);
+        err = lread_error(r, what);
+      }
+      break;
+    }
+
+    char c = r->src[r->pos];
+    lval* item;
+
+    if(c == '(' || c == '{'){
+      if(depth == size){
+        size *= 2;
+        if(open == stack){
+          open = malloc(sizeof(lopen) * size);
+          memcpy(open, stack, sizeof(stack));
+        }else{
+          open = realloc(open, sizeof(lopen) * size);
+        }
+      }
+      open[depth].parent = x;
+      open[depth].close = c == '(' ? ')' : '}';
+      open[depth].line = r->line;
+      open[depth].col = r->col;
+      depth++;
+
+      x = c == '(' ? lval_sexpr() : lval_qexpr();
+      r->pos++;
+      r->col++;
+      continue;
+    }
+
+    if(c == ')' || c == '}'){
+      char what[64];
+      if(depth == 0){
+        snprintf(what, sizeof(what), "unexpected '%c'", c);
+        err = lread_error(r, what);
+        break;
+      }
+      if(open[depth - 1].close != c){
+        snprintf(what, sizeof(what), "expected '%c' to close the list at %i:%i, got '%c'",
+          open[depth - 1].close, open[depth - 1].line, open[depth - 1].col, c);
+        err = lread_error(r, what);
+        break;
+      }
+
+      item = x;
+      x = open[--depth].parent;
+      r->pos++;
+      r->col++;
+    }else if(lread_digit(c) || (c == '-' && r->pos + 1 < r->len && lread_digit(r->src[r->pos + 1]))){
+      item = lread_number(r);
+    }else if(lread_at(r, "True")){
+      item = lval_bool(1);
+      r->pos += 4;
+      r->col += 4;
+    }else if(lread_at(r, "False")){
+      item = lval_bool(0);
+      r->pos += 5;
+      r->col += 5;
+    }else if(lread_symbol_char(c)){
+      item = lread_symbol(r);
+    }else{
+      char what[64];
+      if(c >= ' ' && c <= '~'){
+        snprintf(what, sizeof(what), "unexpected '%c'", c);
+      }else{
+        snprintf(what, sizeof(what), "unexpected byte 0x%02x", (unsigned char)c);
+      }
+      err = lread_error(r, what);
+      break;
+    }
+
+    // a whole expression outside of any brackets is done
+    if(depth == 0){
+      x = item;
+      break;
+    }
+    x = lval_add(x, item);
+  }
+
+  if(err != NULL){
+    if(x != NULL){ lval_del(x); }
+    while(depth > 0){
+      lval* parent = open[--depth].parent;
+      if(parent != NULL){ lval_del(parent); }
+    }
+    x = err;
+    // nothing more is read after a syntax error
+    r->pos = r->len;
+    r->failed = 1;
+  }
+  if(open != stack){ free(open); }
+  return x;
+}
+
+lval* lread(const char* name, const char* src, size_t len){
+  lreader r;
+  lreader_init(&r, name, src, len);
+
+  // the whole input is one S-expression
+  lval* x = lval_sexpr();
+  lval* item;
+  while((item = lread_next(&r)) != NULL){
+    if(r.failed){
+      lval_del(x);
+      return item;
+    }
+    x = lval_add(x, item);
+  }
+  return x;
+}
@@ -0,0 +1,44 @@
+#ifndef lread_h
+#define lread_h
+
+#include "lval.h"
+
+// reader
+// ------
+// turns source text straight into lvals in one pass, no syntax tree in
+// between. the grammar is the one main.c used to give mpc:
+//
+//   number : /-?[0-9]+/
+//   bool   : "True" | "False"
+//   symbol : /[[a-zA-Z0-9_+\-*\/\\=<>!&]+/
+//   sexpr  : '(' <expr>* ')'
+//   qexpr  : '{' <expr>* '}'
+//   expr   : <number> | <bool> | <symbol> | <sexpr> | <qexpr>
+//
+// tried in that order on the longest prefix each matches, so `5x` reads
+// as 5 and x, just like it did.
+
+// reads src one expression at a time. symbols are interned and numbers
+// parsed straight out of src, nothing else is copied.
+typedef struct {
+  const char* name;
+  const char* src;
+  size_t len;
+  size_t pos;
+  int line;
+  int col;
+  // stopped at a syntax error
+  int failed;
+} lreader;
+
+void lreader_init(lreader* r, const char* name, const char* src, size_t len);
+
+// the next expression in src, NULL at the end. a syntax error comes back
+// as an error value, "name:line:col: ..." like mpc's messages, sets
+// failed and ends the input.
+lval* lread_next(lreader* r);
+
+// every expression in src as one S-expression, or the syntax error
+lval* lread(const char* name, const char* src, size_t len);
+
+#endif
@@ -0,0 +1,653 @@
+#include "lslipc.h"
+#include "lread.h"
+#include "builtins.h"
+
+static const char lslipc_magic[6] = "slipc";
+static const char lslimg_magic[6] = "slimg";
+
+static uint64_t lslipc_zigzag(long x){
+  return ((uint64_t)x << 1) ^ (uint64_t)(x < 0 ? -1 : 0);
+}
+
+static long lslipc_unzigzag(uint64_t n){
+  return (long)((n >> 1) ^ (0 - (n & 1)));
+}
+
+uint64_t lslipc_hash(const char* src, size_t len){
+  uint64_t h = 14695981039346656037ull;
+  for(size_t i = 0; i < len; i++){
+    h ^= (unsigned char)src[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+// writing
+// -------
+typedef struct {
+  char* data;
+  size_t len;
+  size_t size;
+} lbuf;
+
+static void lbuf_reserve(lbuf* b, size_t n){
+  if(b->len + n <= b->size){ return; }
+  while(b->len + n > b->size){ b->size = b->size == 0 ? 4096 : b->size * 2; }
+  b->data = realloc(b->data, b->size);
+}
+
+static void lbuf_bytes(lbuf* b, const void* p, size_t n){
+  if(n == 0){ return; }
+  lbuf_reserve(b, n);
+  memcpy(b->data + b->len, p, n);
+  b->len += n;
+}
+
+static void lbuf_byte(lbuf* b, int c){
+  lbuf_reserve(b, 1);
+  b->data[b->len++] = (char)c;
+}
+
+static void lbuf_varint(lbuf* b, uint64_t x){
+  lbuf_reserve(b, 10);
+  while(x >= 0x80){
+    b->data[b->len++] = (char)(x | 0x80);
+    x >>= 7;
+  }
+  b->data[b->len++] = (char)x;
+}
+
+// symbol ids are dense, so the index of each name in the image is kept
+// in an array by id, -1 until the name is first used
+typedef struct {
+  lbuf names;
+  long count;
+  long* index;
+  int index_size;
+} lnames;
+
+static long lnames_index(lnames* n, lsym* s){
+  if(s->id >= n->index_size){
+    int size = n->index_size == 0 ? 256 : n->index_size;
+    while(s->id >= size){ size *= 2; }
+    n->index = realloc(n->index, sizeof(long) * size);
+    for(int i = n->index_size; i < size; i++){ n->index[i] = -1; }
+    n->index_size = size;
+  }
+  if(n->index[s->id] < 0){
+    n->index[s->id] = n->count++;
+    lbuf_varint(&n->names, s->len);
+    lbuf_bytes(&n->names, s->name, s->len);
+  }
+  return n->index[s->id];
+}
+
+// one value, its lists are walked with an explicit stack like lval_print
+static void lslipc_put(lbuf* b, lnames* n, lval* v){
+  struct { lval* v; int i; }* open = NULL;
+  int size = 0;
+  int count = 0;
+
+  while(1){
+    switch(lval_type(v)){
+      case LVAL_NUM: {
+        long x = lval_num_value(v);
+        lbuf_byte(b, LSLIPC_NUM);
+        lbuf_varint(b, lslipc_zigzag(x));
+        break;
+      }
+      case LVAL_BOOL:
+        lbuf_byte(b, lval_truth(v) ? LSLIPC_TRUE : LSLIPC_FALSE);
+        break;
+      case LVAL_SYM:
+        lbuf_byte(b, LSLIPC_SYM);
+        lbuf_varint(b, lnames_index(n, v->symbol));
+        break;
+      case LVAL_ERR:
+        lbuf_byte(b, LSLIPC_ERR);
+        lbuf_varint(b, strlen(v->err));
+        lbuf_bytes(b, v->err, strlen(v->err));
+        break;
+      default:
+        lbuf_byte(b, lval_type(v) == LVAL_QEXPR ? LSLIPC_QEXPR : LSLIPC_SEXPR);
+        lbuf_varint(b, lval_count(v));
+        if(lval_count(v) > 0){
+          if(count == size){
+            size = size == 0 ? 16 : size * 2;
+            open = realloc(open, sizeof(*open) * size);
+          }
+          open[count].v = v;
+          open[count].i = 0;
+          count++;
+        }
+        break;
+    }
+
+    // on to the next item of the innermost list that has one left
+    while(count > 0 && open[count - 1].i == lval_count(open[count - 1].v)){ count--; }
+    if(count == 0){ break; }
+    v = open[count - 1].v->cell[open[count - 1].i++];
+  }
+  free(open);
+}
+
+char* lslipc_compile(const char* name, const char* src, size_t len, size_t* size, lval** err){
+  lbuf forms = {NULL, 0, 0};
+  lnames names = {{NULL, 0, 0}, 0, NULL, 0};
+
+  lreader r;
+  lreader_init(&r, name, src, len);
+  lval* x;
+  while((x = lread_next(&r)) != NULL){
+    if(r.failed){
+      *err = x;
+      free(forms.data);
+      free(names.names.data);
+      free(names.index);
+      return NULL;
+    }
+    lslipc_put(&forms, &names, x);
+    lval_del(x);
+  }
+
+  lbuf image = {NULL, 0, 0};
+  lbuf_bytes(&image, lslipc_magic, sizeof(lslipc_magic));
+  lbuf_varint(&image, LSLIPC_VERSION);
+  lbuf_varint(&image, lslipc_hash(src, len));
+  lbuf_varint(&image, len);
+  lbuf_varint(&image, names.count);
+  lbuf_bytes(&image, names.names.data, names.names.len);
+  lbuf_bytes(&image, forms.data, forms.len);
+
+  free(forms.data);
+  free(names.names.data);
+  free(names.index);
+  *size = image.len;
+  return image.data;
+}
+
+// reading
+// -------
+// 0 when the image ends in the middle of the varint
+static int lslipc_varint(lslipc* c, uint64_t* x){
+  *x = 0;
+  for(int shift = 0; shift < 64 && c->pos < c->len; shift += 7){
+    unsigned char b = c->data[c->pos++];
+    *x |= (uint64_t)(b & 0x7f) << shift;
+    if(b < 0x80){ return 1; }
+  }
+  return 0;
+}
+
+// names are interned once here, every use of one is then an index
+static int lslipc_names(lslipc* c){
+  uint64_t count;
+  if(!lslipc_varint(c, &count) || count > c->len){ return 0; }
+
+  c->symbols = malloc(sizeof(lsym*) * (count + 1));
+  for(uint64_t i = 0; i < count; i++){
+    uint64_t n;
+    if(!lslipc_varint(c, &n) || n > c->len - c->pos){
+      lslipc_close(c);
+      return 0;
+    }
+    c->symbols[i] = lsym_intern_n((const char*)c->data + c->pos, n);
+    c->pos += n;
+  }
+  c->nsymbols = count;
+  return 1;
+}
+
+int lslipc_open(lslipc* c, const char* name, const char* data, size_t len, const char* src, size_t srclen){
+  c->name = name;
+  c->data = (const unsigned char*)data;
+  c->len = len;
+  c->pos = sizeof(lslipc_magic);
+  c->symbols = NULL;
+  c->nsymbols = 0;
+  c->failed = 0;
+
+  uint64_t version, hash, length;
+  if(len < sizeof(lslipc_magic) || memcmp(data, lslipc_magic, sizeof(lslipc_magic)) != 0){ return 0; }
+  if(!lslipc_varint(c, &version) || version != LSLIPC_VERSION){ return 0; }
+  if(!lslipc_varint(c, &hash) || !lslipc_varint(c, &length)){ return 0; }
+  if(length != srclen || hash != lslipc_hash(src, srclen)){ return 0; }
+  return lslipc_names(c);
+}
+
+void lslipc_close(lslipc* c){
+  free(c->symbols);
+  c->symbols = NULL;
+}
+
+// a list whose items are still being read
+typedef struct {
+  int type;
+  int count;
+  int base;
+} lslipc_open_list;
+
+lval* lslipc_next(lslipc* c){
+  if(c->pos == c->len){ return NULL; }
+
+  // finished items wait here until their list is complete
+  lval** items = NULL;
+  int items_size = 0;
+  int items_count = 0;
+  lslipc_open_list* open = NULL;
+  int open_size = 0;
+  int depth = 0;
+
+  lval* x = NULL;
+  while(x == NULL){
+    uint64_t n;
+    lval* item = NULL;
+
+    if(c->pos == c->len){ break; }
+    int tag = c->data[c->pos++];
+    if(tag == LSLIPC_TRUE || tag == LSLIPC_FALSE){
+      item = lval_bool(tag == LSLIPC_TRUE);
+    }else if(!lslipc_varint(c, &n)){
+      break;
+    }else if(tag == LSLIPC_NUM){
+      item = lval_num(lslipc_unzigzag(n));
+    }else if(tag == LSLIPC_SYM){
+      if(n >= (uint64_t)c->nsymbols){ break; }
+      item = lval_sym_interned(c->symbols[n]);
+    }else if(tag == LSLIPC_ERR){
+      if(n > c->len - c->pos){ break; }
+      item = lval_err("%.*s", (int)n, (const char*)c->data + c->pos);
+      c->pos += n;
+    }else if(tag == LSLIPC_SEXPR || tag == LSLIPC_QEXPR){
+      int type = tag == LSLIPC_QEXPR ? LVAL_QEXPR : LVAL_SEXPR;
+      if(n > c->len - c->pos){ break; }
+      if(n == 0){
+        item = lval_list(type, NULL, 0);
+      }else{
+        if(depth == open_size){
+          open_size = open_size == 0 ? 16 : open_size * 2;
+          open = realloc(open, sizeof(lslipc_open_list) * open_size);
+        }
+        open[depth].type = type;
+        open[depth].count = (int)n;
+        open[depth].base = items_count;
+        depth++;
+        continue;
+      }
+    }else{
+      break;
+    }
+
+    // complete every list this item finishes
+    while(1){
+      if(depth == 0){
+        x = item;
+        break;
+      }
+      if(items_count == items_size){
+        items_size = items_size == 0 ? 64 : items_size * 2;
+        items = realloc(items, sizeof(lval*) * items_size);
+      }
+      items[items_count++] = item;
+      lslipc_open_list* l = &open[depth - 1];
+      if(items_count - l->base < l->count){ break; }
+      item = lval_list(l->type, items + l->base, l->count);
+      items_count = l->base;
+      depth--;
+    }
+  }
+
+  if(x == NULL){
+    while(items_count > 0){ lval_del(items[--items_count]); }
+    x = lval_err("%s: damaged image at byte %li", c->name, (long)c->pos);
+    c->pos = c->len;
+    c->failed = 1;
+  }
+  free(items);
+  free(open);
+  return x;
+}
+
+// heap images
+// -----------
+// every value met while writing, by address, with its index in the
+// image. open addressing over the words, no value word is NULL.
+#define LSLIMG_NEW -2
+#define LSLIMG_OPEN -1
+
+typedef struct {
+  lval** keys;
+  long* index;
+  long size;
+  long count;
+} lseen;
+
+static long lseen_slot(lseen* s, lval* v){
+  uint64_t h = (uint64_t)(uintptr_t)v * 0x9e3779b97f4a7c15ull;
+  long i = (long)(h >> 32) & (s->size - 1);
+  while(s->keys[i] != NULL && s->keys[i] != v){ i = (i + 1) & (s->size - 1); }
+  return i;
+}
+
+// LSLIMG_NEW for a value not met yet, LSLIMG_OPEN while its children
+// are being written
+static long lseen_get(lseen* s, lval* v){
+  if(s->size == 0){ return LSLIMG_NEW; }
+  long i = lseen_slot(s, v);
+  return s->keys[i] == NULL ? LSLIMG_NEW : s->index[i];
+}
+
+static void lseen_set(lseen* s, lval* v, long index){
+  // keep the table at most half full
+  if((s->count + 1) * 2 > s->size){
+    lval** keys = s->keys;
+    long* old = s->index;
+    long size = s->size;
+    s->size = size == 0 ? 1024 : size * 2;
+    s->keys = calloc(s->size, sizeof(lval*));
+    s->index = malloc(sizeof(long) * s->size);
+    for(long i = 0; i < size; i++){
+      if(keys[i] == NULL){ continue; }
+      long j = lseen_slot(s, keys[i]);
+      s->keys[j] = keys[i];
+      s->index[j] = old[i];
+    }
+    free(keys);
+    free(old);
+  }
+
+  long i = lseen_slot(s, v);
+  if(s->keys[i] == NULL){
+    s->keys[i] = v;
+    s->count++;
+  }
+  s->index[i] = index;
+}
+
+// the values a value holds: a list's items, or a lambda's formals, body
+// and the values bound in its scope
+static int lslimg_children(lval* v){
+  if(!lval_is_heap(v)){ return 0; }
+  switch(v->type){
+    case LVAL_SEXPR:
+    case LVAL_QEXPR:
+      return v->count;
+    case LVAL_FUNC:
+      return lval_is_builtin(v) ? 0 : 2 + v->func->func_scope->count;
+  }
+  return 0;
+}
+
+static lval* lslimg_child(lval* v, int i){
+  if(v->type != LVAL_FUNC){ return v->cell[i]; }
+  if(i == 0){ return v->func->formals; }
+  if(i == 1){ return v->func->body; }
+  return v->func->func_scope->values[i - 2];
+}
+
+// one value whose children are all written already, 0 when it cannot be
+static int lslimg_put(lbuf* b, lnames* n, lseen* s, lval* v, lval** err){
+  switch(lval_type(v)){
+    case LVAL_NUM:
+      lbuf_byte(b, LSLIMG_NUM);
+      lbuf_varint(b, lslipc_zigzag(lval_num_value(v)));
+      break;
+    case LVAL_BOOL:
+      lbuf_byte(b, lval_truth(v) ? LSLIMG_TRUE : LSLIMG_FALSE);
+      break;
+    case LVAL_SYM:
+      lbuf_byte(b, LSLIMG_SYM);
+      lbuf_varint(b, lnames_index(n, v->symbol));
+      lbuf_varint(b, lslipc_zigzag(v->addr));
+      break;
+    case LVAL_ERR:
+      lbuf_byte(b, LSLIMG_ERR);
+      lbuf_varint(b, strlen(v->err));
+      lbuf_bytes(b, v->err, strlen(v->err));
+      break;
+    case LVAL_FUNC:
+      if(lval_is_builtin(v)){
+        int i = 0;
+        while(builtin_names[i].name != NULL && builtin_names[i].func != v->builtin){ i++; }
+        if(builtin_names[i].name == NULL){
+          *err = lval_err("cannot save a builtin that is not in builtin_names");
+          return 0;
+        }
+        lbuf_byte(b, LSLIMG_BUILTIN);
+        lbuf_varint(b, lnames_index(n, lsym_intern(builtin_names[i].name)));
+      }else{
+        lenv* scope = v->func->func_scope;
+        lbuf_byte(b, LSLIMG_LAMBDA);
+        lbuf_varint(b, lseen_get(s, v->func->formals));
+        lbuf_varint(b, lseen_get(s, v->func->body));
+        lbuf_varint(b, scope->count);
+        for(int i = 0; i < scope->count; i++){
+          lbuf_varint(b, lnames_index(n, scope->symbols[i]));
+          lbuf_varint(b, lseen_get(s, scope->values[i]));
+        }
+      }
+      break;
+    default:
+      lbuf_byte(b, lval_type(v) == LVAL_QEXPR ? LSLIMG_QEXPR : LSLIMG_SEXPR);
+      lbuf_varint(b, lval_count(v));
+      for(int i = 0; i < lval_count(v); i++){
+        lbuf_varint(b, lseen_get(s, v->cell[i]));
+      }
+      break;
+  }
+  return 1;
+}
+
+char* lslimg_save(lenv* global, size_t* size, lval** err){
+  lbuf values = {NULL, 0, 0};
+  lnames names = {{NULL, 0, 0}, 0, NULL, 0};
+  lseen seen = {NULL, NULL, 0, 0};
+  long count = 0;
+  *err = NULL;
+
+  // values whose children are still being written
+  struct { lval* v; int i; }* open = NULL;
+  int open_size = 16;
+  int depth = 0;
+  open = malloc(sizeof(*open) * open_size);
+
+  for(int g = 0; g < global->count && *err == NULL; g++){
+    lval* v = global->values[g];
+    if(lseen_get(&seen, v) != LSLIMG_NEW){ continue; }
+    lseen_set(&seen, v, LSLIMG_OPEN);
+    open[0].v = v;
+    open[0].i = 0;
+    depth = 1;
+
+    while(depth > 0){
+      lval* top = open[depth - 1].v;
+      if(open[depth - 1].i < lslimg_children(top)){
+        lval* x = lslimg_child(top, open[depth - 1].i++);
+        long at = lseen_get(&seen, x);
+        if(at == LSLIMG_OPEN){
+          *err = lval_err("cannot save a value that holds itself");
+          break;
+        }
+        if(at == LSLIMG_NEW){
+          lseen_set(&seen, x, LSLIMG_OPEN);
+          if(depth == open_size){
+            open_size *= 2;
+            open = realloc(open, sizeof(*open) * open_size);
+          }
+          open[depth].v = x;
+          open[depth].i = 0;
+          depth++;
+        }
+        continue;
+      }
+
+      if(!lslimg_put(&values, &names, &seen, top, err)){ break; }
+      lseen_set(&seen, top, count++);
+      depth--;
+    }
+  }
+
+  char* data = NULL;
+  if(*err == NULL){
+    lbuf globals = {NULL, 0, 0};
+    lbuf_varint(&globals, global->count);
+    for(int g = 0; g < global->count; g++){
+      lbuf_varint(&globals, lnames_index(&names, global->symbols[g]));
+      lbuf_varint(&globals, lseen_get(&seen, global->values[g]));
+    }
+
+    lbuf image = {NULL, 0, 0};
+    lbuf_bytes(&image, lslimg_magic, sizeof(lslimg_magic));
+    lbuf_varint(&image, LSLIMG_VERSION);
+    lbuf_varint(&image, names.count);
+    lbuf_bytes(&image, names.names.data, names.names.len);
+    lbuf_varint(&image, count);
+    lbuf_bytes(&image, values.data, values.len);
+    lbuf_bytes(&image, globals.data, globals.len);
+    free(globals.data);
+    *size = image.len;
+    data = image.data;
+  }
+
+  free(open);
+  free(seen.keys);
+  free(seen.index);
+  free(values.data);
+  free(names.names.data);
+  free(names.index);
+  return data;
+}
+
+// an index of a value already built, 0 if it is not one
+static int lslimg_ref(lslipc* c, long made, uint64_t* x){
+  return lslipc_varint(c, x) && *x < (uint64_t)made;
+}
+
+static int lslimg_name(lslipc* c, uint64_t* x){
+  return lslipc_varint(c, x) && *x < (uint64_t)c->nsymbols;
+}
+
+// the next value, NULL when the image is damaged. lambdas come without
+// code, lvm_call compiles one when it is first called.
+static lval* lslimg_value(lslipc* c, lval** values, long made){
+  uint64_t n, f, b;
+  if(c->pos == c->len){ return NULL; }
+  int tag = c->data[c->pos++];
+
+  switch(tag){
+    case LSLIMG_TRUE:
+    case LSLIMG_FALSE:
+      return lval_bool(tag == LSLIMG_TRUE);
+    case LSLIMG_NUM:
+      if(!lslipc_varint(c, &n)){ return NULL; }
+      return lval_num(lslipc_unzigzag(n));
+    case LSLIMG_SYM: {
+      if(!lslimg_name(c, &n) || !lslipc_varint(c, &f)){ return NULL; }
+      lval* x = lval_sym_interned(c->symbols[n]);
+      x->addr = (int)lslipc_unzigzag(f);
+      return x;
+    }
+    case LSLIMG_ERR:
+      if(!lslipc_varint(c, &n) || n > c->len - c->pos){ return NULL; }
+      c->pos += n;
+      return lval_err("%.*s", (int)n, (const char*)c->data + c->pos - n);
+    case LSLIMG_BUILTIN: {
+      if(!lslimg_name(c, &n)){ return NULL; }
+      for(int i = 0; builtin_names[i].name != NULL; i++){
+        if(lsym_intern(builtin_names[i].name) == c->symbols[n]){
+          return lval_func(builtin_names[i].func);
+        }
+      }
+      return NULL;
+    }
+    case LSLIMG_SEXPR:
+    case LSLIMG_QEXPR: {
+      // every item takes at least a byte
+      if(!lslipc_varint(c, &n) || n > c->len - c->pos){ return NULL; }
+      lval** items = malloc(sizeof(lval*) * (n + 1));
+      for(uint64_t i = 0; i < n; i++){
+        if(!lslimg_ref(c, made, &f)){
+          while(i > 0){ lval_del(items[--i]); }
+          free(items);
+          return NULL;
+        }
+        items[i] = lval_copy(values[f]);
+      }
+      lval* x = lval_list(tag == LSLIMG_QEXPR ? LVAL_QEXPR : LVAL_SEXPR, items, (int)n);
+      free(items);
+      return x;
+    }
+    case LSLIMG_LAMBDA: {
+      if(!lslimg_ref(c, made, &f) || !lslimg_ref(c, made, &b) || !lslipc_varint(c, &n)){ return NULL; }
+      if(lval_type(values[f]) != LVAL_QEXPR || lval_type(values[b]) != LVAL_QEXPR){ return NULL; }
+      lval* x = lval_lambda(lval_copy(values[f]), lval_copy(values[b]));
+      for(uint64_t i = 0; i < n; i++){
+        uint64_t name, v;
+        if(!lslimg_name(c, &name) || !lslimg_ref(c, made, &v)){
+          lval_del(x);
+          return NULL;
+        }
+        lval* sym = lval_sym_interned(c->symbols[name]);
+        lenv_put(x->func->func_scope, sym, values[v]);
+        lval_del(sym);
+      }
+      return x;
+    }
+  }
+  return NULL;
+}
+
+lval* lslimg_restore(lenv* global, const char* name, const char* data, size_t len){
+  lslipc c;
+  c.name = name;
+  c.data = (const unsigned char*)data;
+  c.len = len;
+  c.pos = sizeof(lslimg_magic);
+  c.symbols = NULL;
+  c.nsymbols = 0;
+  c.failed = 0;
+
+  uint64_t version;
+  if(len < sizeof(lslimg_magic) || memcmp(data, lslimg_magic, sizeof(lslimg_magic)) != 0 ||
+     !lslipc_varint(&c, &version) || version != LSLIMG_VERSION){
+    return lval_err("%s: not a heap image of this version of slip", name);
+  }
+
+  uint64_t count = 0, nglobals = 0;
+  lval** values = NULL;
+  uint64_t* globals = NULL;
+  long made = 0;
+
+  // every value takes at least a byte, so do the names and bindings
+  int ok = lslipc_names(&c) && lslipc_varint(&c, &count) && count <= len;
+  if(ok){
+    values = malloc(sizeof(lval*) * (count + 1));
+    while(made < (long)count && (values[made] = lslimg_value(&c, values, made)) != NULL){ made++; }
+    ok = made == (long)count && lslipc_varint(&c, &nglobals) && nglobals <= len;
+  }
+  if(ok){
+    globals = malloc(sizeof(uint64_t) * 2 * (nglobals + 1));
+    for(uint64_t i = 0; i < nglobals && ok; i++){
+      ok = lslimg_name(&c, &globals[2 * i]) && lslimg_ref(&c, made, &globals[2 * i + 1]);
+    }
+    ok = ok && c.pos == c.len;
+  }
+
+  lval* result;
+  if(ok){
+    for(uint64_t i = 0; i < nglobals; i++){
+      lval* sym = lval_sym_interned(c.symbols[globals[2 * i]]);
+      lenv_put(global, sym, values[globals[2 * i + 1]]);
+      lval_del(sym);
+    }
+    result = lval_sexpr();
+  }else{
+    result = lval_err("%s: damaged image at byte %li", name, (long)c.pos);
+  }
+
+  while(made > 0){ lval_del(values[--made]); }
+  free(globals);
+  free(values);
+  lslipc_close(&c);
+  return result;
+}
@@ -0,0 +1,95 @@
+#ifndef lslipc_h
+#define lslipc_h
+
+#include "lval.h"
+#include "lenv.h"
+
+// precompiled .slipc images
+// -------------------------
+// an image holds the expressions of a source file already read: every
+// symbol name once, then the expressions in prefix order, where a list
+// gives its length before its items. loading one interns the names and
+// builds the values straight out of the image, no text is scanned. it
+// is only used while the hash of the source it came from still matches.
+//
+//   "slipc\0" version hash length
+//   symbols  name-length name ...
+//   tag [payload] ...
+//
+// every number is an unsigned LEB128 varint, signed ones are zigzagged.
+
+#define LSLIPC_VERSION 1
+
+enum {
+  LSLIPC_NUM,     // zigzag value
+  LSLIPC_TRUE,
+  LSLIPC_FALSE,
+  LSLIPC_SYM,     // index into the names
+  LSLIPC_SEXPR,   // count, then the items
+  LSLIPC_QEXPR,   // count, then the items
+  LSLIPC_ERR      // length, message
+};
+
+typedef struct {
+  const char* name;
+  const unsigned char* data;
+  size_t len;
+  size_t pos;
+  lsym** symbols;
+  long nsymbols;
+  // stopped at a damaged image
+  int failed;
+} lslipc;
+
+// what an image is checked against, FNV-1a over the source
+uint64_t lslipc_hash(const char* src, size_t len);
+
+// the image of every expression in src, malloc'd, with its size in
+// *size. NULL when src has a syntax error, that error is put in *err.
+char* lslipc_compile(const char* name, const char* src, size_t len, size_t* size, lval** err);
+
+// starts reading an image. 0 when it is not one, or was written by
+// another version or from another source than src.
+int lslipc_open(lslipc* c, const char* name, const char* data, size_t len, const char* src, size_t srclen);
+// the next expression, NULL at the end. a damaged image gives an error
+// value, sets failed and ends the input.
+lval* lslipc_next(lslipc* c);
+void lslipc_close(lslipc* c);
+
+// heap images (.slimg)
+// --------------------
+// a heap image is the global scope after it was built: every value
+// reachable from it written once, each after the values it holds, so it
+// refers to them by their index among the values before it. shared
+// values stay shared. symbols keep the slot lval_resolve gave them and
+// lambdas their formals, body and the bindings of their scope. their
+// bytecode is not written, each is compiled when first called. a builtin is written as its name in
+// builtin_names, which is what it is bound to again when restored.
+//
+//   "slimg\0" version
+//   symbols  name-length name ...
+//   count    tag [payload] ...
+//   globals  name value ...
+
+#define LSLIMG_VERSION 1
+
+enum {
+  LSLIMG_NUM,     // zigzag value
+  LSLIMG_TRUE,
+  LSLIMG_FALSE,
+  LSLIMG_SYM,     // name, zigzag addr
+  LSLIMG_SEXPR,   // count, then the items
+  LSLIMG_QEXPR,   // count, then the items
+  LSLIMG_ERR,     // length, message
+  LSLIMG_BUILTIN, // name
+  LSLIMG_LAMBDA   // formals, body, count, then name value per binding
+};
+
+// the image of the global scope, malloc'd, with its size in *size. NULL
+// when some value cannot be written, why is put in *err.
+char* lslimg_save(lenv* global, size_t* size, lval** err);
+// binds everything in the image in global, returns () or an error.
+// nothing is bound from an image that turns out to be damaged.
+lval* lslimg_restore(lenv* global, const char* name, const char* data, size_t len);
+
+#endif
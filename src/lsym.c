@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "lsym.h"
+
+// open addressing table keyed by name, plus an id -> symbol array
+static lsym** table = NULL;
+static int table_size = 0;
+
+static lsym** symbols = NULL;
+static int symbols_count = 0;
+static int symbols_size = 0;
+
+static long bytes = 0;
+
+// FNV-1a
+static unsigned int lsym_hash(const char* name, size_t len){
+  unsigned int h = 2166136261u;
+  for(size_t i = 0; i < len; i++){
+    h ^= (unsigned char)name[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static void lsym_grow(void){
+  int size = table_size == 0 ? 256 : table_size * 2;
+  lsym** grown = calloc(size, sizeof(lsym*));
+
+  for(int i = 0; i < table_size; i++){
+    lsym* s = table[i];
+    if(s == NULL){ continue; }
+    int j = s->hash & (size - 1);
+    while(grown[j] != NULL){ j = (j + 1) & (size - 1); }
+    grown[j] = s;
+  }
+
+  bytes += (long)(size - table_size) * sizeof(lsym*);
+  free(table);
+  table = grown;
+  table_size = size;
+}
+
+lsym* lsym_intern_n(const char* name, size_t len){
+  // keep the load factor under one half
+  if((symbols_count + 1) * 2 > table_size){ lsym_grow(); }
+
+  unsigned int hash = lsym_hash(name, len);
+  int i = hash & (table_size - 1);
+  while(table[i] != NULL){
+    lsym* s = table[i];
+    if(s->hash == hash && (size_t)s->len == len && memcmp(s->name, name, len) == 0){
+      return s;
+    }
+    i = (i + 1) & (table_size - 1);
+  }
+
+  lsym* s = malloc(sizeof(lsym) + len + 1);
+  s->id = symbols_count;
+  s->len = (int)len;
+  s->hash = hash;
+  memcpy(s->name, name, len);
+  s->name[len] = '\0';
+  table[i] = s;
+
+  if(symbols_count == symbols_size){
+    symbols_size = symbols_size == 0 ? 256 : symbols_size * 2;
+    symbols = realloc(symbols, sizeof(lsym*) * symbols_size);
+  }
+  symbols[symbols_count++] = s;
+
+  bytes += sizeof(lsym) + len + 1 + sizeof(lsym*);
+  return s;
+}
+
+lsym* lsym_intern(const char* name){
+  return lsym_intern_n(name, strlen(name));
+}
+
+lsym* lsym_by_id(int id){
+  return id >= 0 && id < symbols_count ? symbols[id] : NULL;
+}
+
+int lsym_count(void){
+  return symbols_count;
+}
+
+long lsym_bytes(void){
+  return bytes;
+}
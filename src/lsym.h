@@ -0,0 +1,27 @@
+#ifndef lsym_h
+#define lsym_h
+
+#include <stddef.h>
+
+// interned symbols
+// ----------------
+// every distinct symbol name is stored once for the whole process.
+// interned symbols are never freed, so an lsym* is a stable identity:
+// two symbols are the same name exactly when the pointers are equal.
+typedef struct lsym lsym;
+struct lsym {
+  int id;             // dense, assigned in interning order
+  int len;
+  unsigned int hash;
+  char name[];
+};
+
+lsym* lsym_intern(const char* name);
+lsym* lsym_intern_n(const char* name, size_t len);
+lsym* lsym_by_id(int id);
+
+// number of interned symbols and the bytes held for them
+int lsym_count(void);
+long lsym_bytes(void);
+
+#endif
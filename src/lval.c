@@ -1,4 +1,10 @@
+#include <assert.h>
+
 #include "lval.h"
+#include "lenv.h"
+#include "lmem.h"
+#include "lgc.h"
+#include "lvm.h"
 
 char* ltype_name(int ltype){
   switch(ltype){
@@ -13,17 +19,161 @@ char* ltype_name(int ltype){
   }
 }
 
+// cell vectors
+// ------------
+// list cells live in a malloc'd vector with a one slot header right
+// before cell[0]. popping the front moves the header up one slot and
+// consing moves it back down, the cells themselves stay put. the slots
+// in front of the header are dead until a cons or the next growth.
+typedef struct {
+  int capacity;   // slots usable from cell[0] on
+  int start;      // dead slots before the header
+} lval_cells;
+
+// the header has to fit the slot it takes
+typedef char lval_cells_fit[sizeof(lval_cells) <= sizeof(lval*) ? 1 : -1];
+
+static lval_cells* lval_cells_of(lval** cell){
+  return (lval_cells*)(cell - 1);
+}
+
+static lval** lval_cells_base(lval** cell){
+  return cell - 1 - lval_cells_of(cell)->start;
+}
+
+static lval** lval_cells_new(int capacity){
+  lval** base = malloc(sizeof(lval*) * (capacity + 1));
+  lval_cells* h = (lval_cells*)base;
+  h->capacity = capacity;
+  h->start = 0;
+  return base + 1;
+}
+
+static void lval_cells_free(lval** cell){
+  if(cell != NULL){ free(lval_cells_base(cell)); }
+}
+
+static long lval_cells_bytes(lval** cell){
+  if(cell == NULL){ return 0; }
+  lval_cells* h = lval_cells_of(cell);
+  return sizeof(lval*) * (h->start + 1 + h->capacity);
+}
+
+// room for at least n cells in v, which the caller owns alone
+static void lval_cells_reserve(lval* v, int n){
+  if(v->cell == NULL){
+    v->cell = lval_cells_new(n < 4 ? 4 : n);
+    return;
+  }
+
+  lval_cells h = *lval_cells_of(v->cell);
+  if(n <= h.capacity){ return; }
+
+  // take the dead slots back first
+  lval** base = lval_cells_base(v->cell);
+  if(h.start > 0){
+    memmove(base + 1, v->cell, sizeof(lval*) * v->count);
+    h.capacity += h.start;
+    h.start = 0;
+  }
+  if(n > h.capacity){
+    h.capacity = h.capacity * 2 > n ? h.capacity * 2 : n;
+    base = realloc(base, sizeof(lval*) * (h.capacity + 1));
+  }
+  *(lval_cells*)base = h;
+  v->cell = base + 1;
+}
+
+// moves the cells back so there are dead slots in front of the header
+static void lval_cells_reserve_front(lval* v){
+  int room = v->count < 4 ? 4 : v->count;
+  int capacity = v->count + 4;
+  lval** base = malloc(sizeof(lval*) * (room + 1 + capacity));
+  lval** cell = base + room + 1;
+  lval_cells* h = lval_cells_of(cell);
+  h->capacity = capacity;
+  h->start = room;
+
+  if(v->count > 0){ memcpy(cell, v->cell, sizeof(lval*) * v->count); }
+  lval_cells_free(v->cell);
+  v->cell = cell;
+}
+
+// every heap lval comes out of the slab allocator
+lval* lval_alloc(void){
+  lval* v = lmem_alloc_kind(sizeof(lval), LMEM_TRACED);
+  v->refs = 1;
+  v->lambda = 0;
+  v->view = 0;
+  v->mark = lgc_alloc_mark();
+  lgc_allocated();
+  return v;
+}
+
+static lval* lval_view_new(int type, lval* base, lval** cell, int count){
+  lval_view* x = lmem_alloc_kind(sizeof(lval_view), LMEM_TRACED);
+  x->v.type = type;
+  x->v.refs = 1;
+  x->v.lambda = 0;
+  x->v.view = 1;
+  x->v.mark = lgc_alloc_mark();
+  x->v.count = count;
+  x->v.cell = cell;
+  x->base = base;
+  lgc_allocated();
+  lgc_write(base);
+  return &x->v;
+}
+
+void lval_free(lval* v){
+  lmem_free(v, v->view ? sizeof(lval_view) : sizeof(lval));
+}
+
+long lval_reclaim(lval* v){
+  long bytes = v->view ? sizeof(lval_view) : sizeof(lval);
+
+  switch(v->type){
+    case LVAL_FUNC:
+      if(!lval_is_builtin(v)){
+        bytes += sizeof(lfunc) + lenv_release(v->func->func_scope);
+        bytes += lcode_reclaim(v->func->code);
+        lmem_free(v->func, sizeof(lfunc));
+      }
+      break;
+    case LVAL_ERR:
+      bytes += strlen(v->err) + 1;
+      free(v->err);
+      break;
+    case LVAL_SEXPR:
+    case LVAL_QEXPR:
+      // a view's cells belong to its base
+      if(!v->view){
+        bytes += lval_cells_bytes(v->cell);
+        lval_cells_free(v->cell);
+      }
+      break;
+  }
+
+  lval_free(v);
+  return bytes;
+}
+
 // lval constructors
 // -----------------
 lval* lval_num(long x){
-  lval* v = malloc(sizeof(lval));
+  // small integers are immediates and need no allocation
+  if(x >= LVAL_FIXNUM_MIN && x <= LVAL_FIXNUM_MAX){
+    return (lval*)(((uintptr_t)x << 1) | LVAL_TAG_FIXNUM);
+  }
+
+  lval* v = lval_alloc();
   v->type = LVAL_NUM;
   v->num = x;
   return v;
 }
 
 lval* lval_err(char* fmt, ...){
-  lval* v = malloc(sizeof(lval));
+  lval* v = lval_alloc();
   v->type = LVAL_ERR;
 
   va_list va;
@@ -38,125 +188,210 @@ lval* lval_err(char* fmt, ...){
 }
 
 lval* lval_sym(char* s){
-  lval* v = malloc(sizeof(lval));
+  return lval_sym_interned(lsym_intern(s));
+}
+
+lval* lval_sym_interned(lsym* sym){
+  lval* v = lval_alloc();
   v->type = LVAL_SYM;
-  v->symbol = malloc(strlen(s)+1);
-  strcpy(v->symbol, s);
+  v->addr = LVAL_ADDR_DYNAMIC;
+  v->symbol = sym;
   return v;
 }
 
+// the empty lists are immediates, lval_add allocates on the first append
 lval* lval_sexpr(void){
-  lval* v = malloc(sizeof(lval));
-  v->type = LVAL_SEXPR;
-  v->count = 0;
-  v->cell = NULL;
-  return v;
+  return LVAL_NIL_SEXPR;
 }
 
 lval* lval_qexpr(void){
-  lval* v = malloc(sizeof(lval));
-  v->type = LVAL_QEXPR;
+  return LVAL_NIL_QEXPR;
+}
+
+static lval* lval_list_new(int type){
+  lval* v = lval_alloc();
+  v->type = type;
   v->count = 0;
   v->cell = NULL;
   return v;
 }
 
+lval* lval_list(int type, lval** items, int n){
+  if(n == 0){ return type == LVAL_QEXPR ? LVAL_NIL_QEXPR : LVAL_NIL_SEXPR; }
+
+  lval* v = lval_list_new(type);
+  v->count = n;
+  v->cell = lval_cells_new(n);
+  for(int i = 0; i < n; i++){
+    v->cell[i] = items[i];
+    lgc_write(items[i]);
+  }
+  return v;
+}
+
 lval* lval_func(lbuiltin func){
-  lval* v = malloc(sizeof(lval));
+  lval* v = lval_alloc();
   v->type = LVAL_FUNC;
+  v->lambda = 0;
   v->builtin = func;
   return v;
 }
 
 lval* lval_bool(int b){
-  lval* v = malloc(sizeof(lval));
-  v->type = LVAL_BOOL;
-  v->truth = b ? 1 : 0;
-
-  return v;
+  return b ? LVAL_TRUE : LVAL_FALSE;
 }
 
 
 lval* lval_lambda(lval* formals, lval* body){
-  lval* v = malloc(sizeof(lval));
+  lval* v = lval_alloc();
   v->type = LVAL_FUNC;
 
-  v->builtin = NULL;
-  v->func_scope = lenv_new();
-  v->formals = formals;
-  v->body = body;
+  v->lambda = 1;
+  v->func = lmem_alloc(sizeof(lfunc));
+  v->func->func_scope = lenv_new();
+  v->func->formals = formals;
+  v->func->body = body;
+  v->func->code = NULL;
+  lgc_write(formals);
+  lgc_write(body);
 
   return v;
 }
 
-// delte, add, other operations to lval
-void lval_del(lval* v){
+// the structural walkers below keep their own stacks instead of
+// recursing, so how deeply values nest is bounded by memory alone
+typedef struct {
+  lval** items;
+  int count;
+  int size;
+} lval_stack;
+
+static void lval_stack_push(lval_stack* s, lval* v){
+  if(s->count == s->size){
+    s->size = s->size == 0 ? 64 : s->size * 2;
+    s->items = realloc(s->items, sizeof(lval*) * s->size);
+  }
+  s->items[s->count++] = v;
+}
+
+// values whose last reference is gone, waiting to be freed
+static lval_stack dying;
+static int draining = 0;
+
+// frees what v owns, children only lose a reference
+static void lval_destroy(lval* v){
   switch(v->type){
-    case LVAL_BOOL:
     case LVAL_NUM: break;
     case LVAL_FUNC:
-      if(v->builtin == NULL){
-        lenv_del(v->func_scope);
-        lval_del(v->formals);
-        lval_del(v->body);
+      if(!lval_is_builtin(v)){
+        lenv_del(v->func->func_scope);
+        lval_del(v->func->formals);
+        lval_del(v->func->body);
+        lcode_release(v->func->code);
+        lmem_free(v->func, sizeof(lfunc));
       }
       break;
 
     case LVAL_ERR: free(v->err); break;
-    case LVAL_SYM: free(v->symbol); break;
+    // interned names are shared and never freed
+    case LVAL_SYM: break;
 
     case LVAL_QEXPR:
     case LVAL_SEXPR:
+      if(v->view){
+        lval_del(((lval_view*)v)->base);
+        break;
+      }
       // free each cell from the cells array
       for(int i = 0; i < v->count; i++){
         lval_del(v->cell[i]);
       }
       // free the cells array
-      free(v->cell);
+      lval_cells_free(v->cell);
     break;
   }
   // free the whole lvalue
-  free(v);
+  lval_free(v);
+}
+
+// delte, add, other operations to lval
+void lval_del(lval* v){
+  if(!lval_is_heap(v)){ return; }
+
+  // drop one reference, the last one frees the value
+  if(v->refs == LVAL_REFS_MAX){ return; }
+  if(--v->refs > 0){ return; }
+
+  // children dying while a value is freed queue up behind it
+  if(draining){
+    lval_stack_push(&dying, v);
+    return;
+  }
+
+  draining = 1;
+  lval_destroy(v);
+  while(dying.count > 0){
+    lval_destroy(dying.items[--dying.count]);
+  }
+  draining = 0;
+}
+
+lval* lval_reserve(lval* v, int n){
+  if(!lval_is_heap(v)){ v = lval_list_new(lval_type(v)); }
+  v = lval_unshare(v);
+  lval_cells_reserve(v, n);
+  return v;
 }
 
 lval* lval_add(lval* v, lval* next){
-  v->count++;
-  v->cell = realloc(v->cell, sizeof(lval*) * v->count);
-  v->cell[v->count-1] = next;
+  v = lval_reserve(v, lval_count(v) + 1);
+  lgc_write(next);
+
+  v->cell[v->count++] = next;
   return v;
 }
 
 
+// values are immutable once shared, so a copy is another reference
 lval* lval_copy(lval* v){
-  lval* x = malloc(sizeof(lval));
+  if(lval_is_heap(v) && v->refs != LVAL_REFS_MAX){ v->refs++; }
+  lgc_write(v);
+  return v;
+}
+
+// one level copy, children and closure values are shared
+static lval* lval_dup(lval* v){
+  lval* x = lval_alloc();
   x->type = v->type;
 
   switch(v->type){
     case LVAL_NUM: x->num = v->num; break;
-    case LVAL_BOOL: x->truth = v->truth; break;
     case LVAL_FUNC:
-      if(v->builtin != NULL){
+      x->lambda = v->lambda;
+      if(lval_is_builtin(v)){
         x->builtin = v->builtin;
       }else{
-        x->builtin = NULL;
-        x->func_scope = lenv_copy(v->func_scope);
-        x->formals = lval_copy(v->formals);
-        x->body = lval_copy(v->body);
+        x->func = lmem_alloc(sizeof(lfunc));
+        x->func->func_scope = lenv_copy(v->func->func_scope);
+        x->func->formals = lval_copy(v->func->formals);
+        x->func->body = lval_copy(v->func->body);
+        x->func->code = lcode_retain(v->func->code);
       }
     break;
 
+
     case LVAL_ERR:
       x->err = malloc(strlen(v->err) + 1);
       strcpy(x->err, v->err);
       break;
     case LVAL_SYM:
-      x->symbol = malloc(strlen(v->symbol) + 1);
-      strcpy(x->symbol, v->symbol);
+      x->addr = v->addr;
+      x->symbol = v->symbol;
       break;
     case LVAL_SEXPR:
     case LVAL_QEXPR:
       x->count = v->count;
-      x->cell = malloc(sizeof(lval*) * x->count);
+      x->cell = lval_cells_new(x->count);
       for(int i = 0; i < x->count; i++){
         x->cell[i] = lval_copy(v->cell[i]);
       }
@@ -166,107 +401,350 @@ lval* lval_copy(lval* v){
   return x;
 }
 
+// give up one reference to v in exchange for a value the caller owns
+// alone and may change. copies only the top level when v is shared.
+lval* lval_unshare(lval* v){
+  if(!lval_is_heap(v) || (v->refs == 1 && !v->view)){ return v; }
+
+  lval* x = lval_dup(v);
+  lval_del(v);
+  return x;
+}
+
+// v has to be owned by the caller alone and not be a view, see
+// lval_unshare. popping writes into the cell vector, which a view shares
+// with its base.
 lval* lval_pop(lval* v, int i){
+  assert(v->refs == 1 && !v->view);
   lval* x = v->cell[i];
+  v->count--;
 
-  memmove(&v->cell[i], &v->cell[i+1], sizeof(lval*) * (v->count - i - 1));
+  if(i == 0){
+    // the header moves into the slot cell[0] leaves behind
+    lval_cells h = *lval_cells_of(v->cell);
+    h.capacity--;
+    h.start++;
+    v->cell++;
+    *lval_cells_of(v->cell) = h;
+    return x;
+  }
 
-  v->count--;
-  v->cell = realloc(v->cell, sizeof(lval*) * v->count);
+  memmove(&v->cell[i], &v->cell[i+1], sizeof(lval*) * (v->count - i));
   return x;
 }
 
 lval* lval_take(lval* v, int i){
+  // a shared list stays intact, take another reference to the cell
+  if(v->refs != 1 || v->view){
+    lval* x = lval_copy(v->cell[i]);
+    lval_del(v);
+    return x;
+  }
+
   lval* x = lval_pop(v, i);
   lval_del(v);
   return x;
 }
 
+lval* lval_rest(lval* v){
+  if(lval_count(v) <= 1){
+    int type = lval_type(v);
+    lval_del(v);
+    return type == LVAL_QEXPR ? LVAL_NIL_QEXPR : LVAL_NIL_SEXPR;
+  }
+
+  if(v->refs == 1 && !v->view){
+    lval_del(lval_pop(v, 0));
+    return v;
+  }
+  if(v->refs == 1){
+    v->cell++;
+    v->count--;
+    return v;
+  }
+
+  // shared, look at the same cells one further on
+  lval* base = v->view ? ((lval_view*)v)->base : v;
+  lval* x = lval_view_new(v->type, lval_copy(base), v->cell + 1, v->count - 1);
+  lval_del(v);
+  return x;
+}
+
+lval* lval_cons(lval* x, lval* list){
+  list = lval_unshare(list);
+  if(!lval_is_heap(list)){ return lval_list(lval_type(list), &x, 1); }
+  lgc_write(x);
+
+  // keep room in front, so consing onto a list of our own is amortized O(1)
+  if(list->cell == NULL || lval_cells_of(list->cell)->start == 0){
+    lval_cells_reserve_front(list);
+  }
+
+  lval_cells h = *lval_cells_of(list->cell);
+  h.capacity++;
+  h.start--;
+  list->cell--;
+  *lval_cells_of(list->cell) = h;
+  list->cell[0] = x;
+  list->count++;
+  return list;
+}
+
 lval* lval_join(lval* x, lval* y){
+  int n = lval_count(y);
+  if(n == 0){
+    lval_del(y);
+    return x;
+  }
 
-  while(y->count > 0){
-    x = lval_add(x, lval_pop(y, 0));
+  x = lval_reserve(x, lval_count(x) + n);
+  memcpy(&x->cell[x->count], y->cell, sizeof(lval*) * n);
+  x->count += n;
+  for(int i = x->count - n; i < x->count; i++){
+    lgc_write(x->cell[i]);
   }
 
+  // the cells moved over, a shared y keeps its own and x gets references
+  if(y->refs == 1 && !y->view){
+    y->count = 0;
+  }else{
+    for(int i = x->count - n; i < x->count; i++){
+      lval_copy(x->cell[i]);
+    }
+  }
   lval_del(y);
   return x;
 }
 
+// lexical addressing pass, run once when a lambda is built.
+// formals resolve to their frame slot (slot i holds formal i once the
+// lambda is fully applied), every other symbol to the global scope.
+// scoping is dynamic, so these are only hints: lenv_get checks that the
+// binding is really there and falls back to a full lookup otherwise.
+void lval_resolve(lval* body, lval* formals){
+  lval_stack todo = {0};
+  lval_stack_push(&todo, body);
+
+  while(todo.count > 0){
+    lval* x = todo.items[--todo.count];
+    switch(lval_type(x)){
+      case LVAL_SYM:
+        x->addr = LVAL_ADDR_GLOBAL;
+        for(int i = 0; i < lval_count(formals); i++){
+          lval* formal = formals->cell[i];
+          if(lval_type(formal) == LVAL_SYM && formal->symbol == x->symbol){
+            x->addr = i;
+            break;
+          }
+        }
+        break;
+      case LVAL_SEXPR:
+      case LVAL_QEXPR:
+        for(int i = 0; i < lval_count(x); i++){
+          lval_stack_push(&todo, x->cell[i]);
+        }
+        break;
+    }
+  }
+  free(todo.items);
+}
+
+// switch between s- and q-expression, keeping the contents
+lval* lval_retype(lval* v, int type){
+  if(!lval_is_heap(v)){
+    return type == LVAL_QEXPR ? LVAL_NIL_QEXPR : LVAL_NIL_SEXPR;
+  }
+  if(v->type == type){ return v; }
+  v = lval_unshare(v);
+  v->type = type;
+  return v;
+}
+
 // print
-void lval_expr_print(lval* v, char open, char close){
-  putchar(open);
-  for (int i = 0; i < v->count; i++){
+// everything printed is gathered in one buffer and written to stdout in
+// large chunks, numbers are formatted without going through printf
+#define LVAL_OUT_SIZE (64 * 1024)
+
+static char out[LVAL_OUT_SIZE];
+static size_t out_len = 0;
+static int out_buffered = 0;
+
+void lval_print_buffered(int on){
+  out_buffered = on;
+}
 
-    lval_print(v->cell[i]);
+void lval_print_flush(void){
+  if(out_len > 0){
+    fwrite(out, 1, out_len, stdout);
+    out_len = 0;
+  }
+  fflush(stdout);
+}
 
-    if (i != (v->count-1)){
-      putchar(' ');
+static void lval_out(const char* s, size_t n){
+  if(out_len + n > LVAL_OUT_SIZE){
+    lval_print_flush();
+    if(n > LVAL_OUT_SIZE){
+      fwrite(s, 1, n, stdout);
+      return;
     }
   }
-  putchar(close);
+  memcpy(out + out_len, s, n);
+  out_len += n;
 }
 
-void lval_print(lval* v){
-  switch(v->type){
+static void lval_out_str(const char* s){
+  lval_out(s, strlen(s));
+}
+
+static void lval_out_char(char c){
+  if(out_len == LVAL_OUT_SIZE){ lval_print_flush(); }
+  out[out_len++] = c;
+}
+
+static void lval_out_num(long x){
+  char digits[24];
+  int i = sizeof(digits);
+  // negate as unsigned, so LONG_MIN does not overflow
+  unsigned long u = x < 0 ? 0ul - (unsigned long)x : (unsigned long)x;
+  do{
+    digits[--i] = '0' + u % 10;
+    u /= 10;
+  }while(u > 0);
+  if(x < 0){ digits[--i] = '-'; }
+  lval_out(digits + i, sizeof(digits) - i);
+}
+
+// a lambda prints as (\\ formals body), those two are its children
+static int lval_print_count(lval* v){
+  return lval_type(v) == LVAL_FUNC ? 2 : lval_count(v);
+}
+
+static lval* lval_print_child(lval* v, int i){
+  if(lval_type(v) == LVAL_FUNC){ return i == 0 ? v->func->formals : v->func->body; }
+  return v->cell[i];
+}
+
+// prints v, or only its opening when it has children to walk
+static int lval_print_open(lval* v){
+  switch(lval_type(v)){
     case LVAL_BOOL:
-      printf(v->truth ? "True" : "False"); break;
+      lval_out_str(lval_truth(v) ? "True" : "False"); break;
     case LVAL_NUM:
-      printf("%li", v->num); break;
+      lval_out_num(lval_num_value(v)); break;
     case LVAL_ERR:
-      printf("Error: %s", v->err); break;
+      lval_out_str("Error: ");
+      lval_out_str(v->err);
+      break;
     case LVAL_SYM:
-      printf("%s", v->symbol); break;
-    case LVAL_SEXPR: lval_expr_print(v, '(', ')'); break;
-    case LVAL_QEXPR: lval_expr_print(v, '{', '}'); break;
+      lval_out(v->symbol->name, v->symbol->len); break;
+    case LVAL_SEXPR: lval_out_char('('); return 1;
+    case LVAL_QEXPR: lval_out_char('{'); return 1;
     case LVAL_FUNC:
-      if(v->builtin != NULL){
-        printf("<function>");
-      }else{
-        printf("(\\ "); lval_print(v->formals);
-        putchar(' '); lval_print(v->body); putchar(')');
+      if(lval_is_builtin(v)){
+        lval_out_str("<function>");
+        break;
       }
-    break;
+      lval_out_str("(\\ ");
+      return 1;
   }
+  return 0;
 }
 
-void lval_println(lval* v){
-  lval_print(v); putchar('\n');
+void lval_print(lval* v){
+  if(!lval_print_open(v)){ return; }
+
+  struct { lval* v; int i; }* open = malloc(sizeof(*open) * 16);
+  int size = 16;
+  int count = 1;
+  open[0].v = v;
+  open[0].i = 0;
+
+  while(count > 0){
+    lval* x = open[count - 1].v;
+    int i = open[count - 1].i++;
+
+    if(i == lval_print_count(x)){
+      lval_out_char(lval_type(x) == LVAL_QEXPR ? '}' : ')');
+      count--;
+      continue;
+    }
+
+    if(i > 0){ lval_out_char(' '); }
+    lval* child = lval_print_child(x, i);
+    if(lval_print_open(child)){
+      if(count == size){
+        size *= 2;
+        open = realloc(open, sizeof(*open) * size);
+      }
+      open[count].v = child;
+      open[count].i = 0;
+      count++;
+    }
+  }
+  free(open);
 }
 
-lval* lval_eq(lval* a, lval* b){
-  int is_equal;
+void lval_println(lval* v){
+  lval_print(v);
+  lval_out_char('\n');
+  if(!out_buffered){ lval_print_flush(); }
+}
 
-  if(a->type != b->type){
-    is_equal =  0;
-  }
+static int lval_equal_shallow(lval* a, lval* b, lval_stack* pending){
+  if(a == b){ return 1; }
+  if(lval_type(a) != lval_type(b)){ return 0; }
 
-  switch(a->type){
+  switch(lval_type(a)){
     case LVAL_NUM:
-      is_equal = (a->num == b->num);
-      break;
+      return lval_num_value(a) == lval_num_value(b);
+    // booleans are immediates, so distinct words are distinct values
     case LVAL_BOOL:
-      is_equal = (a->truth == b->truth);
-      break;
+      return 0;
     case LVAL_SYM:
-      is_equal = (strstr(a->symbol, b->symbol));
-      break;
+      return a->symbol == b->symbol;
     case LVAL_FUNC:
-      is_equal = lval_eq(a->formals, b->formals)->truth &&
-        lval_eq(a->body, b->body)->truth;
-      break;
+      if(lval_is_builtin(a) || lval_is_builtin(b)){
+        return lval_is_builtin(a) && lval_is_builtin(b) &&
+          a->builtin == b->builtin;
+      }
+      lval_stack_push(pending, a->func->formals);
+      lval_stack_push(pending, b->func->formals);
+      lval_stack_push(pending, a->func->body);
+      lval_stack_push(pending, b->func->body);
+      return 1;
     case LVAL_SEXPR:
     case LVAL_QEXPR:
-      if(a->count != b->count){ is_equal = 0; break; }
+      if(lval_count(a) != lval_count(b)){ return 0; }
 
-      for(int i = 0; i < a->count; i++){
-        is_equal = is_equal && lval_eq(a->cell[i], b->cell[i])->truth;
-        if(!is_equal){break;}
+      for(int i = 0; i < lval_count(a); i++){
+        lval_stack_push(pending, a->cell[i]);
+        lval_stack_push(pending, b->cell[i]);
       }
-    break;
-    default:
-      return lval_err("Uncomparable type");
-      break;
+      return 1;
+  }
+
+  return 0;
+}
+
+int lval_equal(lval* a, lval* b){
+  // pairs still to compare, children are pushed as their parents match
+  lval_stack pending = {0};
+  int equal = lval_equal_shallow(a, b, &pending);
+
+  while(equal && pending.count > 0){
+    pending.count -= 2;
+    equal = lval_equal_shallow(pending.items[pending.count], pending.items[pending.count + 1], &pending);
+  }
+
+  free(pending.items);
+  return equal;
+}
+
+lval* lval_eq(lval* a, lval* b){
+  if(lval_type(a) == LVAL_ERR || lval_type(b) == LVAL_ERR){
+    return lval_err("Uncomparable type");
   }
 
-  return lval_bool(is_equal);
+  return lval_bool(lval_equal(a, b));
 }
@@ -5,6 +5,9 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <stdint.h>
+
+#include "lsym.h"
 
 // #include "lenv.h"
 
@@ -14,31 +17,76 @@ struct lval;
 typedef struct lval lval;
 struct lenv;
 typedef struct lenv lenv;
+struct lfunc;
+typedef struct lfunc lfunc;
+struct lcode;
 
 typedef lval*(*lbuiltin)(lenv*, lval*);
 
 
 // declares a new struct, lval
+// a heap value is a narrow tag plus one word of payload, 16 bytes in all.
+// anything bigger (error text, lambda metadata) lives out of line.
+//
+// heap values are reference counted and immutable once shared:
+// lval_copy only takes another reference, and code that wants to change
+// a value first makes it its own with lval_unshare.
 struct lval {
   // type
-  int type;
-
-  // primitives
-  long num;
-  int truth;
-  char* err;
-  char* symbol;
-
-  // lists
-  int count;
-  struct lval** cell;
+  unsigned int type : 4;
+  // LVAL_FUNC: set for lambdas, clear for builtins
+  unsigned int lambda : 1;
+  // collector mark, see lgc.h
+  unsigned int mark : 1;
+  // lists: the cells belong to another list, see lval_view
+  unsigned int view : 1;
+  // sticks at LVAL_REFS_MAX, such values are only freed by the collector
+  unsigned int refs : 25;
+
+  union {
+    // lists
+    int count;
+    // symbols: where lval_resolve expects the binding, see LVAL_ADDR_*
+    int addr;
+  };
+
+  union {
+    long num;
+    char* err;
+    lsym* symbol;
+    struct lval** cell;
+    lbuiltin builtin;
+    lfunc* func;
+  };
+};
 
-  // functions
-  lbuiltin builtin;
+// cold lambda data, only touched when the lambda is called or printed
+struct lfunc {
   lval* formals;
   lval* body;
   lenv* func_scope;
+  // compiled body, NULL when the body cannot be evaluated or, for a
+  // lambda restored from a heap image, until it is first called
+  struct lcode* code;
 };
+
+// a list that shares a run of another list's cells instead of owning
+// its own, so taking the rest of a shared list costs no copy. the view
+// holds a reference to the list that owns the cells and none to the
+// cells themselves. views are never changed in place: lval_unshare
+// turns them into ordinary lists first.
+typedef struct {
+  lval v;
+  lval* base;
+} lval_view;
+
+#define LVAL_REFS_MAX ((1u << 25) - 1)
+
+// resolved symbol addresses, a non-negative addr is a slot in the frame
+// of the lambda whose body contains the symbol
+#define LVAL_ADDR_DYNAMIC -1
+#define LVAL_ADDR_GLOBAL -2
+
 // valid types of LVAL
 enum {
   LVAL_ERR,
@@ -50,14 +98,75 @@ enum {
   LVAL_BOOL
 };
 
+// tagged value words
+// ------------------
+// heap values are 8 byte aligned, so the low bits of an lval* are free:
+//   ...xx1  fixnum, the value lives in the upper bits
+//   ...000  pointer to a heap struct lval
+//   ...010  constant immediates (booleans and the empty lists)
+#define LVAL_TAG_MASK  7
+#define LVAL_TAG_FIXNUM 1
+#define LVAL_TAG_CONST 2
+
+#define LVAL_FALSE      ((lval*)(uintptr_t)0x02)
+#define LVAL_TRUE       ((lval*)(uintptr_t)0x0a)
+#define LVAL_NIL_SEXPR  ((lval*)(uintptr_t)0x12)
+#define LVAL_NIL_QEXPR  ((lval*)(uintptr_t)0x1a)
+
+#define LVAL_FIXNUM_MAX (INTPTR_MAX >> 1)
+#define LVAL_FIXNUM_MIN (INTPTR_MIN >> 1)
+
+static inline int lval_is_heap(lval* v){
+  return ((uintptr_t)v & LVAL_TAG_MASK) == 0;
+}
+
+static inline int lval_is_fixnum(lval* v){
+  return ((uintptr_t)v & LVAL_TAG_FIXNUM) != 0;
+}
+
+static inline int lval_type(lval* v){
+  if(lval_is_fixnum(v)){ return LVAL_NUM; }
+  if(lval_is_heap(v)){ return v->type; }
+  if(v == LVAL_TRUE || v == LVAL_FALSE){ return LVAL_BOOL; }
+  return v == LVAL_NIL_QEXPR ? LVAL_QEXPR : LVAL_SEXPR;
+}
+
+static inline long lval_num_value(lval* v){
+  // arithmetic shift keeps the sign of negative fixnums
+  return lval_is_fixnum(v) ? (long)((intptr_t)v >> 1) : v->num;
+}
+
+static inline int lval_is_builtin(lval* v){
+  return !v->lambda;
+}
+
+static inline int lval_truth(lval* v){
+  return v == LVAL_TRUE;
+}
+
+// number of cells in an s/q-expression, the empty immediates have none
+static inline int lval_count(lval* v){
+  return lval_is_heap(v) ? v->count : 0;
+}
+
 char* ltype_name(int ltype);
 
+// storage for heap values
+lval* lval_alloc(void);
+void lval_free(lval* v);
+// free what v owns directly, leaving its children alone. used by the
+// collector on unreachable values, returns the bytes released.
+long lval_reclaim(lval* v);
+
 //constructors
 lval* lval_num(long x);
 lval* lval_err(char* err, ...);
 lval* lval_sym(char* sym);
+lval* lval_sym_interned(lsym* sym);
 lval* lval_sexpr(void);
 lval* lval_qexpr(void);
+// list of the given type holding n values, takes their references
+lval* lval_list(int type, lval** items, int n);
 lval* lval_func(lbuiltin func);
 lval* lval_lambda(lval* formal, lval* body);
 lval* lval_bool(int v);
@@ -65,23 +174,35 @@ lval* lval_bool(int v);
 //add, delete
 void lval_del(lval* v);
 lval* lval_add(lval* v, lval* next);
+// v unshared and with room for n cells, so n adds will not reallocate
+lval* lval_reserve(lval* v, int n);
 
 // print
-void lval_expr_print(lval* v, char open, char close);
 void lval_print(lval* v);
 void lval_println(lval* v);
+// printing goes through a buffer in front of stdout. unless it is set to
+// buffered, every printed line is written out straight away.
+void lval_print_buffered(int on);
+// write out everything printed so far
+void lval_print_flush(void);
 
 lval* lval_pop(lval* v, int i);
 lval* lval_copy(lval* v);
+lval* lval_unshare(lval* v);
 lval* lval_take(lval* v, int i);
+// v without its first cell, shares the cells when v is shared
+lval* lval_rest(lval* v);
+// x in front of the cells of list
+lval* lval_cons(lval* x, lval* list);
 lval* lval_join(lval* x, lval* y);
+void lval_resolve(lval* body, lval* formals);
+lval* lval_retype(lval* v, int type);
 
 // eval
 lval* lval_eval(lenv* e, lval* v);
-lval* lval_eval_sexpr(lenv* e, lval* v);
-lval* lval_call(lenv* e, lval* f, lval* v);
 
 // bool
+int lval_equal(lval* a, lval* b);
 lval* lval_eq(lval* a, lval* b);
 
 #endif
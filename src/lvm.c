@@ -0,0 +1,716 @@
+#include "lvm.h"
+#include "lenv.h"
+#include "builtins.h"
+#include "lgc.h"
+
+// Compiler
+// --------
+typedef struct {
+  int* ops;
+  int count;
+  int size;
+  lval** consts;
+  int nconsts;
+  int csize;
+  int depth;
+  int max;
+} lcompiler;
+
+static int lvm_emit(lcompiler* c, int op){
+  if(c->count == c->size){
+    c->size = c->size == 0 ? 32 : c->size * 2;
+    c->ops = realloc(c->ops, sizeof(int) * c->size);
+  }
+  c->ops[c->count] = op;
+  return c->count++;
+}
+
+static int lvm_const(lcompiler* c, lval* x){
+  if(c->nconsts == c->csize){
+    c->csize = c->csize == 0 ? 8 : c->csize * 2;
+    c->consts = realloc(c->consts, sizeof(lval*) * c->csize);
+  }
+  c->consts[c->nconsts] = lval_copy(x);
+  return c->nconsts++;
+}
+
+static void lvm_push(lcompiler* c, int n){
+  c->depth += n;
+  if(c->depth > c->max){ c->max = c->depth; }
+}
+
+// the compiler walks expressions with its own stack of tasks, so deeply
+// nested code compiles without deep C recursion
+enum {
+  LTASK_EXPR,     // compile x
+  LTASK_SEXPR,    // compile x as an s-expression, even when quoted
+  LTASK_CALL,     // all n values are pushed, emit the call
+  LTASK_IF_THEN,  // predicate is pushed, emit IF and the then branch
+  LTASK_IF_ELSE,  // then branch is done, emit the else branch
+  LTASK_IF_END    // both branches are done, patch the jumps
+};
+
+typedef struct {
+  int kind;
+  lval* x;
+  int tail;
+  // call: opcode. if: operand positions to patch and the stack depth
+  int a;
+  int b;
+  int depth;
+} ltask;
+
+typedef struct {
+  ltask* items;
+  int count;
+  int size;
+} ltasks;
+
+static ltask* lvm_task(ltasks* t, int kind, lval* x, int tail){
+  if(t->count == t->size){
+    t->size = t->size == 0 ? 32 : t->size * 2;
+    t->items = realloc(t->items, sizeof(ltask) * t->size);
+  }
+  ltask* task = &t->items[t->count++];
+  task->kind = kind;
+  task->x = x;
+  task->tail = tail;
+  task->a = task->b = task->depth = 0;
+  return task;
+}
+
+static int lvm_is_if(lval* x){
+  return lval_count(x) == 4 && lval_type(x->cell[0]) == LVAL_SYM &&
+    strcmp(x->cell[0]->symbol->name, "if") == 0 &&
+    lval_type(x->cell[2]) == LVAL_QEXPR && lval_type(x->cell[3]) == LVAL_QEXPR;
+}
+
+static int lvm_call_op(lval* x){
+  lval* head = x->cell[0];
+  if(lval_type(head) != LVAL_SYM){ return LOP_CALL; }
+
+  char* name = head->symbol->name;
+  if(strcmp(name, "+") == 0 || strcmp(name, "-") == 0 ||
+    strcmp(name, "*") == 0 || strcmp(name, "/") == 0){
+    return LOP_ARITH;
+  }
+  if(strcmp(name, "==") == 0 && lval_count(x) == 3){ return LOP_EQ; }
+  if(strcmp(name, "def") == 0 || strcmp(name, "let") == 0){ return LOP_BIND; }
+  return LOP_CALL;
+}
+
+// tail is set for the expression whose value is the value of the code
+static void lvm_emit_code(lcompiler* c, lval* x, int kind, int tail){
+  ltasks todo = {0};
+  lvm_task(&todo, kind, x, tail);
+
+  while(todo.count > 0){
+    ltask task = todo.items[--todo.count];
+    x = task.x;
+    tail = task.tail;
+
+    switch(task.kind){
+      case LTASK_EXPR:
+        if(lval_type(x) == LVAL_SYM){
+          lvm_emit(c, LOP_LOAD); lvm_emit(c, lvm_const(c, x));
+          lvm_push(c, 1);
+          break;
+        }
+        if(lval_type(x) != LVAL_SEXPR){
+          // everything else evaluates to itself
+          lvm_emit(c, LOP_CONST); lvm_emit(c, lvm_const(c, x));
+          lvm_push(c, 1);
+          break;
+        }
+        // fall through
+      case LTASK_SEXPR: {
+        int n = lval_count(x);
+
+        // () is its own value, (x) is the value of x. an empty branch
+        // of an inline `if` is {} run as code, which also gives ()
+        if(n == 0){
+          lvm_emit(c, LOP_CONST); lvm_emit(c, lvm_const(c, LVAL_NIL_SEXPR));
+          lvm_push(c, 1);
+          break;
+        }
+        if(n == 1){
+          lvm_task(&todo, LTASK_EXPR, x->cell[0], tail);
+          break;
+        }
+
+        // if pred {then} {else}: the branches are compiled inline
+        if(lvm_is_if(x)){
+          lvm_task(&todo, LTASK_IF_THEN, x, tail);
+          lvm_task(&todo, LTASK_EXPR, x->cell[1], 0);
+          lvm_task(&todo, LTASK_EXPR, x->cell[0], 0);
+          break;
+        }
+
+        // tasks run last in first out, so the head is pushed last
+        lvm_task(&todo, LTASK_CALL, x, tail)->a = lvm_call_op(x);
+        for(int i = n - 1; i >= 0; i--){
+          lvm_task(&todo, LTASK_EXPR, x->cell[i], 0);
+        }
+        break;
+      }
+
+      case LTASK_CALL: {
+        int n = lval_count(x);
+        lvm_emit(c, task.a);
+        lvm_emit(c, n);
+        lvm_emit(c, tail);
+        c->depth -= n - 1;
+        break;
+      }
+
+      case LTASK_IF_THEN: {
+        // room for the branches when `if` has to be called after all
+        lvm_push(c, 2);
+        c->depth -= 2;
+        lvm_emit(c, LOP_IF);
+        lvm_emit(c, lvm_const(c, x->cell[2]));
+        lvm_emit(c, lvm_const(c, x->cell[3]));
+        ltask* next = lvm_task(&todo, LTASK_IF_ELSE, x, tail);
+        next->a = lvm_emit(c, 0);
+        next->b = lvm_emit(c, 0);
+        lvm_emit(c, tail);
+        c->depth -= 2;
+        next->depth = c->depth;
+        lvm_task(&todo, LTASK_SEXPR, x->cell[2], tail);
+        break;
+      }
+
+      case LTASK_IF_ELSE: {
+        lvm_emit(c, LOP_JUMP);
+        ltask* next = lvm_task(&todo, LTASK_IF_END, x, tail);
+        next->a = lvm_emit(c, 0);
+        next->b = task.b;
+
+        c->depth = task.depth;
+        c->ops[task.a] = c->count;
+        lvm_task(&todo, LTASK_SEXPR, x->cell[3], tail);
+        break;
+      }
+
+      case LTASK_IF_END:
+        c->ops[task.a] = c->count;
+        c->ops[task.b] = c->count;
+        break;
+    }
+  }
+
+  free(todo.items);
+}
+
+static lcode* lvm_finish(lcompiler* c){
+  lvm_emit(c, LOP_RETURN);
+
+  lcode* code = malloc(sizeof(lcode));
+  code->refs = 1;
+  code->ops = c->ops;
+  code->count = c->count;
+  code->consts = c->consts;
+  code->nconsts = c->nconsts;
+  code->stack = c->max;
+  return code;
+}
+
+// formals are tracked as a bit per slot, later slots are never moved
+#define LVM_MOVE_SLOTS 64
+
+static uint64_t lvm_slot_bit(lval* x){
+  if(lval_type(x) != LVAL_SYM || x->addr < 0 || x->addr >= LVM_MOVE_SLOTS){ return 0; }
+  return (uint64_t)1 << x->addr;
+}
+
+// formals named anywhere in a quoted list, which `if` or `eval` may
+// still evaluate in the frame
+static uint64_t lvm_slots_in(lval* x){
+  uint64_t bits = 0;
+  lval** todo = NULL;
+  int count = 0;
+  int size = 0;
+  while(1){
+    bits |= lvm_slot_bit(x);
+    int n = lval_type(x) == LVAL_SEXPR || lval_type(x) == LVAL_QEXPR ? lval_count(x) : 0;
+    for(int i = 0; i < n; i++){
+      if(count == size){
+        size = size == 0 ? 16 : size * 2;
+        todo = realloc(todo, sizeof(lval*) * size);
+      }
+      todo[count++] = x->cell[i];
+    }
+    if(count == 0){ break; }
+    x = todo[--count];
+  }
+  free(todo);
+  return bits;
+}
+
+// turns every LOAD of a formal that no path after it needs again into a
+// MOVE. jumps only go forward, so one backward pass sees every successor
+// of an instruction before the instruction itself.
+static void lvm_mark_moves(lcode* code){
+  int* ops = code->ops;
+  int n = code->count;
+  int* starts = malloc(sizeof(int) * n);
+  int count = 0;
+  for(int pc = 0; pc < n; count++){
+    starts[count] = pc;
+    switch(ops[pc]){
+      case LOP_RETURN: pc += 1; break;
+      case LOP_CONST:
+      case LOP_LOAD:
+      case LOP_JUMP: pc += 2; break;
+      case LOP_IF: pc += 6; break;
+      default: pc += 3; break;
+    }
+  }
+
+  // formals each instruction's code on may still look up
+  uint64_t* live = calloc(n + 1, sizeof(uint64_t));
+  while(count > 0){
+    int pc = starts[--count];
+    uint64_t bits = 0;
+    switch(ops[pc]){
+      case LOP_RETURN:
+        break;
+      case LOP_JUMP:
+        bits = live[ops[pc + 1]];
+        break;
+      case LOP_IF:
+        bits = live[pc + 6] | live[ops[pc + 3]] | live[ops[pc + 4]] |
+          lvm_slots_in(code->consts[ops[pc + 1]]) | lvm_slots_in(code->consts[ops[pc + 2]]);
+        break;
+      case LOP_CONST:
+        bits = live[pc + 2] | lvm_slots_in(code->consts[ops[pc + 1]]);
+        break;
+      case LOP_LOAD: {
+        uint64_t bit = lvm_slot_bit(code->consts[ops[pc + 1]]);
+        bits = live[pc + 2];
+        if(bit != 0 && (bits & bit) == 0){ ops[pc] = LOP_MOVE; }
+        bits |= bit;
+        break;
+      }
+      default:
+        bits = live[pc + 3];
+        break;
+    }
+    live[pc] = bits;
+  }
+  free(live);
+  free(starts);
+}
+
+lcode* lvm_compile(lval* body){
+  // builtin_eval rejects these, calling the lambda reports that
+  if(lval_type(body) != LVAL_QEXPR || lval_count(body) == 0){ return NULL; }
+
+  lcompiler c = {0};
+  lvm_emit_code(&c, body, LTASK_SEXPR, 1);
+  lcode* code = lvm_finish(&c);
+  lvm_mark_moves(code);
+  return code;
+}
+
+// code for an expression that is evaluated once
+static lcode* lvm_compile_expr(lval* x){
+  lcompiler c = {0};
+  lvm_emit_code(&c, x, LTASK_EXPR, 1);
+  return lvm_finish(&c);
+}
+
+lcode* lcode_retain(lcode* code){
+  if(code != NULL){ code->refs++; }
+  return code;
+}
+
+long lcode_reclaim(lcode* code){
+  if(code == NULL || --code->refs > 0){ return 0; }
+
+  long bytes = sizeof(lcode) + sizeof(int) * code->count + sizeof(lval*) * code->nconsts;
+  free(code->ops);
+  free(code->consts);
+  free(code);
+  return bytes;
+}
+
+void lcode_release(lcode* code){
+  if(code == NULL || code->refs > 1){
+    lcode_reclaim(code);
+    return;
+  }
+
+  for(int i = 0; i < code->nconsts; i++){
+    lval_del(code->consts[i]);
+  }
+  lcode_reclaim(code);
+}
+
+// Virtual machine
+// ---------------
+// all evaluation runs here. calls do not recurse in C: a lambda body, or
+// whatever `if` and `eval` evaluate, gets a frame on a heap allocated
+// stack. a call in tail position replaces the caller's frame instead.
+//
+// a body can see its caller's bindings through dynamic scoping, so a tail
+// call cannot just drop the caller's scope. the callee's scope takes over
+// whatever it does not shadow, which keeps lookups as they were.
+
+typedef struct {
+  lcode* code;    // a reference is held while the frame runs
+  int pc;
+  lenv* e;
+  // the lambda whose scope e is, NULL when e belongs to a frame below
+  lval* owner;
+} lframe;
+
+static lframe* frames = NULL;
+static int frame_size = 0;
+static int frame_count = 0;
+static long depth_limit = LVM_DEPTH_LIMIT;
+
+// one operand stack shared by every frame, a frame only touches the
+// slots above the point where it started
+static lval** stack = NULL;
+static int stack_size = 0;
+static int sp = 0;
+
+long lvm_depth_limit(void){
+  return depth_limit;
+}
+
+void lvm_set_depth_limit(long limit){
+  depth_limit = limit;
+}
+
+static void lvm_reserve(int n){
+  if(sp + n <= stack_size){ return; }
+  while(sp + n > stack_size){
+    stack_size = stack_size == 0 ? 256 : stack_size * 2;
+  }
+  stack = realloc(stack, sizeof(lval*) * stack_size);
+}
+
+static void lvm_leave(lframe* f){
+  lcode_release(f->code);
+  if(f->owner != NULL){ lval_del(f->owner); }
+}
+
+// start running code, consumes the code and the owner. returns 0 when
+// the frame would go past the depth limit.
+static int lvm_enter(lcode* code, lenv* e, lval* owner, int tail){
+  lvm_reserve(code->stack);
+
+  if(tail){
+    lframe* f = &frames[frame_count - 1];
+    if(owner == NULL){
+      // same scope, the new frame keeps it alive now
+      owner = f->owner;
+      f->owner = NULL;
+    }else if(f->owner != NULL){
+      lenv_merge(e, f->e);
+    }
+    lvm_leave(f);
+    f->code = code;
+    f->pc = 0;
+    f->e = e;
+    f->owner = owner;
+    return 1;
+  }
+
+  if(frame_count >= depth_limit){
+    lcode_release(code);
+    if(owner != NULL){ lval_del(owner); }
+    return 0;
+  }
+
+  if(frame_count == frame_size){
+    frame_size = frame_size == 0 ? 64 : frame_size * 2;
+    frames = realloc(frames, sizeof(lframe) * frame_size);
+  }
+  lframe* f = &frames[frame_count++];
+  f->code = code;
+  f->pc = 0;
+  f->e = e;
+  f->owner = owner;
+  return 1;
+}
+
+static lval* lvm_too_deep(void){
+  return lval_err("Evaluation nested deeper than %li frames", depth_limit);
+}
+
+// evaluate x in e, consumes x. the value is pushed, unless x needs code
+// run for it, which gets a frame.
+static void lvm_expr(lenv* e, lval* x, int tail){
+  if(lval_type(x) == LVAL_SYM){
+    stack[sp++] = lenv_get(e, x);
+    lval_del(x);
+    return;
+  }
+  // () is an immediate and evaluates to itself
+  if(lval_type(x) != LVAL_SEXPR || !lval_is_heap(x)){
+    stack[sp++] = x;
+    return;
+  }
+
+  lcode* code = lvm_compile_expr(x);
+  lval_del(x);
+  if(!lvm_enter(code, e, NULL, tail)){ stack[sp++] = lvm_too_deep(); }
+}
+
+// apply the top n values like an s-expression whose children are
+// evaluated. pushes the result, or enters the frame that computes it.
+static void lvm_call(lenv* e, int n, int tail){
+  sp -= n;
+  lval** items = &stack[sp];
+
+  // if there are any errors, return the error
+  for(int i = 0; i < n; i++){
+    if(lval_type(items[i]) == LVAL_ERR){
+      lval* err = items[i];
+      for(int j = 0; j < n; j++){
+        if(j != i){ lval_del(items[j]); }
+      }
+      stack[sp++] = err;
+      return;
+    }
+  }
+
+  // Take the first expression in the S-expression
+  // which should be a function
+  lval* f = items[0];
+  if(lval_type(f) != LVAL_FUNC){
+    for(int i = 0; i < n; i++){ lval_del(items[i]); }
+    stack[sp++] = lval_err("S-expression should start with a function!");
+    return;
+  }
+
+  // if there is a builtin function, call it.
+  if(lval_is_builtin(f)){
+    lbuiltin builtin = f->builtin;
+    lbuiltin then = builtin_tail_call(builtin);
+    lval_del(f);
+    lval* v = lval_list(LVAL_SEXPR, items + 1, n - 1);
+    if(then != NULL){
+      lvm_expr(e, then(e, v), tail);
+    }else{
+      // the builtin may run code of its own and move the stack
+      lval* r = builtin(e, v);
+      stack[sp++] = r;
+    }
+    return;
+  }
+
+  // we need to check that no more than the suppliable arguments are supplied
+  // less is ok for currying
+  if(n - 1 > lval_count(f->func->formals)){
+    for(int i = 0; i < n; i++){ lval_del(items[i]); }
+    stack[sp++] = lval_err("More arguments supplied than available in function.");
+    return;
+  }
+
+  // lambdas restored from a heap image are compiled on their first call,
+  // before unsharing so every holder of the lambda gets the code
+  if(f->func->code == NULL){ f->func->code = lvm_compile(f->func->body); }
+
+  // binding arguments changes the lambda, so work on our own copy
+  f = lval_unshare(f);
+  f->func->formals = lval_unshare(f->func->formals);
+
+  for(int i = 1; i < n; i++){
+    lval* symbol = lval_pop(f->func->formals, 0);
+    lenv_put(f->func->func_scope, symbol, items[i]);
+    lval_del(symbol); lval_del(items[i]);
+  }
+
+  if(lval_count(f->func->formals) != 0){
+    stack[sp++] = f;
+    return;
+  }
+
+  lenv* scope = f->func->func_scope;
+  scope->parent = e;
+
+  lcode* code = lcode_retain(f->func->code);
+  if(code == NULL){
+    // the body cannot be evaluated, `eval` says why
+    lval* err = builtin_eval_expr(scope, lval_add(lval_sexpr(), lval_copy(f->func->body)));
+    lval_del(f);
+    stack[sp++] = err;
+    return;
+  }
+  if(!lvm_enter(code, scope, f, tail)){ stack[sp++] = lvm_too_deep(); }
+}
+
+static int lvm_is_builtin(lval* head, lbuiltin f){
+  return lval_type(head) == LVAL_FUNC && lval_is_builtin(head) && head->builtin == f;
+}
+
+static int lvm_any_error(lval** items, int n){
+  for(int i = 0; i < n; i++){
+    if(lval_type(items[i]) == LVAL_ERR){ return 1; }
+  }
+  return 0;
+}
+
+// + - * / straight on the stack, no argument list is built
+static lval* lvm_arith(lval** items, int n){
+  if(lval_type(items[0]) != LVAL_FUNC || !lval_is_builtin(items[0])){ return NULL; }
+  larith kernel = builtin_arith(items[0]->builtin);
+  if(kernel == NULL || lvm_any_error(items, n)){ return NULL; }
+  return kernel(items + 1, n - 1);
+}
+
+static lval* lvm_eq(lval** items, int n){
+  if(!lvm_is_builtin(items[0], builtin_eq) || lvm_any_error(items, n)){ return NULL; }
+  return lval_bool(lval_equal(items[1], items[2]));
+}
+
+// def {a b} x y and let {a b} x y
+static lval* lvm_bind(lenv* e, lval** items, int n){
+  int global = lvm_is_builtin(items[0], builtin_def);
+  if(!global && !lvm_is_builtin(items[0], builtin_put)){ return NULL; }
+  if(lvm_any_error(items, n)){ return NULL; }
+
+  lval* symbols = items[1];
+  if(lval_type(symbols) != LVAL_QEXPR || lval_count(symbols) != n - 2){ return NULL; }
+  for(int i = 0; i < n - 2; i++){
+    if(lval_type(symbols->cell[i]) != LVAL_SYM){ return NULL; }
+  }
+
+  for(int i = 0; i < n - 2; i++){
+    if(global){ lenv_def(e, symbols->cell[i], items[i + 2]); }
+    else{ lenv_put(e, symbols->cell[i], items[i + 2]); }
+  }
+  return lval_sexpr();
+}
+
+// what a formal is bound to after its last use, one value shared by all
+static lval* unbound = NULL;
+
+static lval* lvm_unbound(void){
+  if(unbound == NULL){ unbound = lval_err("unbound symbol"); }
+  return unbound;
+}
+
+void lvm_shade_roots(void){
+  if(unbound != NULL){ lgc_shade(unbound); }
+  for(int i = 0; i < sp; i++){ lgc_shade(stack[i]); }
+  for(int i = 0; i < frame_count; i++){
+    lframe* f = &frames[i];
+    if(f->owner != NULL){ lgc_shade(f->owner); }
+    for(int j = 0; j < f->code->nconsts; j++){ lgc_shade(f->code->consts[j]); }
+    // the global scope is the collector's own root
+    if(!f->e->global){
+      for(int j = 0; j < f->e->count; j++){ lgc_shade(f->e->values[j]); }
+    }
+  }
+}
+
+// run frames until the frame at index bottom returns
+static lval* lvm_run(int bottom){
+  lframe* f = &frames[frame_count - 1];
+  int* ops = f->code->ops;
+  lval** consts = f->code->consts;
+  lenv* e = f->e;
+  int pc = 0;
+
+  while(1){
+    switch(ops[pc]){
+      case LOP_CONST:
+        stack[sp++] = lval_copy(consts[ops[pc + 1]]);
+        pc += 2;
+        continue;
+
+      case LOP_LOAD:
+        stack[sp++] = lenv_get(e, consts[ops[pc + 1]]);
+        pc += 2;
+        continue;
+
+      case LOP_MOVE: {
+        lval* sym = consts[ops[pc + 1]];
+        int slot = sym->addr;
+        if(f->owner != NULL && slot < e->count && e->symbols[slot] == sym->symbol){
+          stack[sp++] = e->values[slot];
+          e->values[slot] = lval_copy(lvm_unbound());
+        }else{
+          stack[sp++] = lenv_get(e, sym);
+        }
+        pc += 2;
+        continue;
+      }
+
+      case LOP_ARITH:
+      case LOP_EQ:
+      case LOP_BIND: {
+        int n = ops[pc + 1];
+        lval** items = &stack[sp - n];
+        lval* r = NULL;
+        if(ops[pc] == LOP_ARITH){ r = lvm_arith(items, n); }
+        if(ops[pc] == LOP_EQ){ r = lvm_eq(items, n); }
+        if(ops[pc] == LOP_BIND){ r = lvm_bind(e, items, n); }
+
+        if(r != NULL){
+          for(int i = 0; i < n; i++){ lval_del(items[i]); }
+          sp -= n;
+          stack[sp++] = r;
+          pc += 3;
+          continue;
+        }
+      }
+      // fall through, the builtin itself has to run
+      case LOP_CALL:
+        // long evaluations collect at calls. only the outermost run does:
+        // a builtin that ran a nested one holds values of its own
+        if(bottom == 0 && lgc_pending()){ lgc_safepoint(lenv_global()); }
+        f->pc = pc + 3;
+        lvm_call(e, ops[pc + 1], ops[pc + 2]);
+        break;
+
+      case LOP_IF: {
+        lval* pred = stack[sp - 1];
+        lval* head = stack[sp - 2];
+        if(lvm_is_builtin(head, builtin_if) && lval_type(pred) == LVAL_BOOL){
+          sp -= 2;
+          lval_del(head);
+          pc = lval_truth(pred) ? pc + 6 : ops[pc + 3];
+          continue;
+        }
+        // not the builtin, or it will fail: let `if` itself have a go
+        stack[sp++] = lval_copy(consts[ops[pc + 1]]);
+        stack[sp++] = lval_copy(consts[ops[pc + 2]]);
+        f->pc = ops[pc + 4];
+        lvm_call(e, 4, ops[pc + 5]);
+        break;
+      }
+
+      case LOP_JUMP:
+        pc = ops[pc + 1];
+        continue;
+
+      case LOP_RETURN:
+        lvm_leave(f);
+        frame_count--;
+        if(frame_count == bottom){ return stack[--sp]; }
+        break;
+    }
+
+    // the frame changed: a call entered one or replaced it, or one returned
+    f = &frames[frame_count - 1];
+    ops = f->code->ops;
+    consts = f->code->consts;
+    e = f->e;
+    pc = f->pc;
+  }
+}
+
+lval* lval_eval(lenv* e, lval* v){
+  int bottom = frame_count;
+  lvm_reserve(1);
+  lvm_expr(e, v, 0);
+  // symbols and constants need no code run
+  if(frame_count == bottom){ return stack[--sp]; }
+  return lvm_run(bottom);
+}
@@ -0,0 +1,63 @@
+#ifndef lvm_h
+#define lvm_h
+
+#include "lval.h"
+
+// bytecode and the machine that runs it
+// --------------------------------------
+// builtin_lambda compiles the body once into a flat instruction array,
+// anything else lval_eval is given is compiled when it is evaluated.
+// every s-expression still evaluates all of its children first.
+// calls whose head names `if`, an arithmetic operator, `==`, `def` or
+// `let` get their own opcodes, which check at run time that the head
+// really is that builtin and otherwise do an ordinary call.
+//
+// a formal is loaded with MOVE at its last use in a lambda body: the
+// value is taken out of the frame instead of copied, so a list passed on
+// there is not shared and `cons` can change it in place. looking the name
+// up in that frame afterwards, through dynamic scoping, fails as unbound.
+
+// frames the machine may hold before evaluation fails with an error
+#define LVM_DEPTH_LIMIT 1000000
+
+enum {
+  LOP_CONST,    // k           push consts[k]
+  LOP_LOAD,     // k           push the value of symbol consts[k]
+  LOP_MOVE,     // k           like LOAD, for the last use of a formal
+  LOP_CALL,     // n tail      apply the top n values as an s-expression
+  LOP_ARITH,    // n tail      like CALL, runs the + - * / kernel on the stack
+  LOP_EQ,       // n tail      like CALL, fast path for ==
+  LOP_BIND,     // n tail      like CALL, fast path for def and let
+  LOP_IF,       // t f else end tail
+                //             pops pred and head, branches or calls `if`
+  LOP_JUMP,     // target
+  LOP_RETURN
+};
+
+typedef struct lcode lcode;
+struct lcode {
+  int refs;
+  int* ops;
+  int count;
+  lval** consts;
+  int nconsts;
+  // deepest the operand stack gets while running this code
+  int stack;
+};
+
+// NULL when the body cannot be evaluated, calling the lambda fails then
+lcode* lvm_compile(lval* body);
+
+long lvm_depth_limit(void);
+void lvm_set_depth_limit(long limit);
+
+// shades what running frames hold: operand stack, frame scopes, code
+// constants. the collector's roots besides the global scope
+void lvm_shade_roots(void);
+
+lcode* lcode_retain(lcode* code);
+void lcode_release(lcode* code);
+// free the code without touching its constants, for the collector
+long lcode_reclaim(lcode* code);
+
+#endif
@@ -1,5 +1,8 @@
+#define _POSIX_C_SOURCE 200112L
   #include <stdlib.h>
 #include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
 
 #include <editline/readline.h>
 #include <editline/history.h>
@@ -9,8 +12,9 @@
 #include "lval.h"
 #include "lenv.h"
 #include "builtins.h"
-
-lval* lval_eval_sexpr(lenv* e, lval* v);
+#include "lgc.h"
+#include "lread.h"
+#include "lload.h"
 
 // Evaluate the Abstract Syntax Tree
 // ---------------------------------
@@ -33,7 +37,8 @@ lval* lval_read(mpc_ast_t* ast){
 
   if(strstr(ast->tag, "number")) {return lval_read_num(ast);}
   if(strstr(ast->tag, "bool")){ return lval_read_bool(ast); }
-  if(strstr(ast->tag, "symbol")) {return lval_sym(ast->contents);}
+  // symbols are interned as they are read
+  if(strstr(ast->tag, "symbol")) {return lval_sym_interned(lsym_intern(ast->contents));}
 
   lval* x = NULL;
   if(strcmp(ast->tag, ">") == 0) { x = lval_sexpr();}
@@ -52,105 +57,94 @@ lval* lval_read(mpc_ast_t* ast){
   return x;
 }
 
-lval* lval_eval(lenv* e, lval* v){
-  if(v->type == LVAL_SYM){
-    lval* x = lenv_get(e, v);
-    lval_del(v);
-    return x;
-  }
-  if(v->type == LVAL_SEXPR){ return lval_eval_sexpr(e, v); }
-  return v;
+void lenv_add_builtin(lenv* e, char* sym, lbuiltin func){
+  lval* symbol = lval_sym(sym);
+  lval* value = lval_func(func);
+  lenv_put(e, symbol, value);
+  lval_del(symbol); lval_del(value);
 }
 
-lval* lval_eval_sexpr(lenv* e, lval* v){
-
-  // evaluate child expressions
-  for(int i = 0; i < v->count; i++){
-    v->cell[i] = lval_eval(e, v->cell[i]);
-  }
-
-  // if there are any errors, return the error
-  for (int i = 0; i < v->count; i++){
-    if (v->cell[i]->type == LVAL_ERR){ return lval_take(v, i); }
-  }
-
-  // if it is an empty expression, return 0
-  if (v->count == 0){ return v; }
-  // if it is a single expression, return the contents
-  if (v->count == 1){ return lval_take(v, 0); }
-
-  // Take the first expression in the S-expression
-  // which should be a function
-  lval* f = lval_pop(v, 0);
-  if (f->type != LVAL_FUNC){
-    lval_del(f); lval_del(v);
-    return lval_err("S-expression should start with a function!");
+void lenv_add_builtins(lenv* e){
+  for(int i = 0; builtin_names[i].name != NULL; i++){
+    lenv_add_builtin(e, builtin_names[i].name, builtin_names[i].func);
   }
-
-  // symbol (operator)
-  lval* result = lval_call(e, f, v);
-  lval_del(f);
-  return result;
 }
 
-lval* lval_call(lenv* e, lval* f, lval* v){
-  // if there is a builtin function, call it.
-  if(f->builtin != NULL){
-    return f->builtin(e, v);
+// batch mode reads stdin this many bytes at a time
+#define SLIP_BATCH_BLOCK (64 * 1024)
+
+// runs one line of input, a NULL grammar reads it with lread
+static void slip_line(lenv* global, char* input, size_t len, mpc_parser_t* grammar){
+  lval* x;
+  if(grammar != NULL){
+    mpc_result_t r;
+    if(!mpc_parse("<stdin>", input, grammar, &r)){
+      // mpc prints straight to stdout
+      lval_print_flush();
+      mpc_err_print(r.error);
+      mpc_err_delete(r.error);
+      return;
+    }
+    // parse the AST
+    x = lval_read(r.output);
+    mpc_ast_delete(r.output);
+  }else{
+    x = lread("<stdin>", input, len);
+    if(lval_type(x) == LVAL_ERR){
+      lval_println(x);
+      lval_del(x);
+      return;
+    }
   }
 
-  // we need to check that no more than the suppliable arguments are supplied
-  // less is ok for currying
-  LASSERT(v, v->count <= f->formals->count,
-    "More arguments supplied than available in function.");
-
-  int args_count = v->count;
-  for(int i = 0; i < args_count; i++){
-    lval* symbol = lval_pop(f->formals, 0);
-    lval* bind  = lval_pop(v, 0);
+  // evaluate the l-values
+  x = lval_eval(global, x);
+  lval_println(x);
+  lval_del(x);
 
-    lenv_put(f->func_scope, symbol, bind);
-    lval_del(symbol); lval_del(bind);
-  }
-
-  lval_del(v);
+  // nothing but the global scope holds values here
+  lgc_safepoint(global);
+}
 
-  if(f->formals->count == 0){
+// stdin without editline: read in blocks, every line is run like a line
+// typed at the REPL, without prompts
+static void slip_batch(lenv* global, mpc_parser_t* grammar){
+  size_t size = SLIP_BATCH_BLOCK;
+  char* buf = malloc(size + 1);
+  size_t len = 0;
+
+  while(1){
+    ssize_t n = read(STDIN_FILENO, buf + len, size - len);
+    if(n < 0 && errno == EINTR){ continue; }
+    if(n > 0){ len += n; }
+
+    // run every complete line
+    size_t start = 0;
+    char* nl;
+    while((nl = memchr(buf + start, '\n', len - start)) != NULL){
+      *nl = '\0';
+      slip_line(global, buf + start, nl - (buf + start), grammar);
+      start = nl - buf + 1;
+    }
 
-    f->func_scope->parent = e;
+    if(n <= 0){
+      // the last line may not end in a newline
+      if(start < len){
+        buf[len] = '\0';
+        slip_line(global, buf + start, len - start, grammar);
+      }
+      break;
+    }
 
-    return builtin_eval(f->func_scope,
-      lval_add(lval_sexpr(), lval_copy(f->body)));
-  }else{
-    return lval_copy(f);
+    // keep the unfinished line, a line longer than the buffer grows it
+    memmove(buf, buf + start, len - start);
+    len -= start;
+    if(len == size){
+      size *= 2;
+      buf = realloc(buf, size + 1);
+    }
   }
-}
-
-void lenv_add_builtin(lenv* e, char* sym, lbuiltin func){
-  lval* symbol = lval_sym(sym);
-  lval* value = lval_func(func);
-  lenv_put(e, symbol, value);
-  lval_del(symbol); lval_del(value);
-}
-
-void lenv_add_builtins(lenv* e){
-  lenv_add_builtin(e, "list", builtin_list);
-  lenv_add_builtin(e, "eval", builtin_eval);
-  lenv_add_builtin(e, "head", builtin_head);
-  lenv_add_builtin(e, "tail", builtin_tail);
-  lenv_add_builtin(e, "join", builtin_join);
-  lenv_add_builtin(e, "def", builtin_def);
-  lenv_add_builtin(e, "let", builtin_put);
-  lenv_add_builtin(e, "\\", builtin_lambda);
-  lenv_add_builtin(e, "print", builtin_print);
-
-  lenv_add_builtin(e, "if", builtin_if);
-  lenv_add_builtin(e, "==", builtin_eq);
-
-  lenv_add_builtin(e, "+", builtin_add);
-  lenv_add_builtin(e, "-", builtin_sub);
-  lenv_add_builtin(e, "/", builtin_div);
-  lenv_add_builtin(e, "*", builtin_mul);
+  free(buf);
 }
 
 // main loop
@@ -166,7 +160,7 @@ int main(int argc, char** argv){
     mpc_parser_t* Slip      = mpc_new("slip");
 
 
-    mpca_lang(MPCA_LANG_DEFAULT,
+    mpca_lang(MPCA_LANG_ARENA,
             "                                               \
             number  : /-?[0-9]+/;                           \
             bool    : \"True\" | \"False\";                     \
@@ -178,41 +172,92 @@ int main(int argc, char** argv){
             ",
             Number, Bool, Symbol, SExpr, QExpr, Expr, Slip);
 
-    puts("Slip version 0.0.0.0");
-    puts("Press ctrl+c to exit");
-
-    lenv* global = lenv_new();
-    lenv_add_builtins(global);
-    // REPL(oop)
-    while(1){
-        char* input = readline("slip> ");
+    // the mpc grammar is still there for comparing against the reader
+    int use_mpc = 0;
+    // without a terminal there is no one to prompt
+    int batch = !isatty(STDIN_FILENO);
+    int compile = 0;
+    char* image = NULL;
+    int files = 0;
+    for(int i = 1; i < argc; i++){
+      if(strcmp(argv[i], "--mpc") == 0){
+        use_mpc = 1;
+      }else if(strcmp(argv[i], "--batch") == 0){
+        batch = 1;
+      }else if(strcmp(argv[i], "--compile") == 0){
+        compile = 1;
+      }else if(strcmp(argv[i], "--image") == 0){
+        if(i + 1 == argc){
+          fputs("--image needs a file\n", stderr);
+          mpc_cleanup(7, Number, Bool, Symbol, SExpr, QExpr, Expr, Slip);
+          return 1;
+        }
+        image = argv[++i];
+      }else{
+        // file names are gathered at the front of argv
+        argv[++files] = argv[i];
+      }
+    }
 
-        add_history(input);
+    // results only have to show up straight away at the REPL, where
+    // someone may be reading them through a pipe (`slip | tee log`)
+    int repl = !batch && !compile && files == 0;
+    lval_print_buffered(!repl && !isatty(STDOUT_FILENO));
 
-        mpc_result_t r;
+    lenv* global = lenv_new_global();
+    lenv_add_builtins(global);
 
-        if(mpc_parse("<stdin>", input, Slip, &r)){
-          // AST successfully read
-          // mpc_ast_print(r.output);
+    int status = 0;
+    if(image != NULL){
+      // `slip --image boot.slimg` starts from a scope written by save-image
+      lval* x = lload_image(global, image);
+      if(lval_type(x) == LVAL_ERR){
+        lval_println(x);
+        status = 1;
+      }
+      lval_del(x);
+    }
 
-          // parse the AST
-          lval* x = lval_read(r.output);
-          // evaluate the l-values
-          x = lval_eval(global, x);
+    if(status != 0){
+      // no point running anything without the scope it was meant for
+    }else if(compile){
+      // `slip --compile a.slip` writes a.slipc without running anything
+      for(int i = 1; i <= files; i++){
+        lval* x = lload_compile(argv[i]);
+        if(lval_type(x) == LVAL_ERR){
           lval_println(x);
-          lval_del(x);
-
-          mpc_ast_delete(r.output);
-        }else{
-          mpc_err_print(r.error);
-          mpc_err_delete(r.error);
+          status = 1;
         }
-
+        lval_del(x);
+      }
+    }else if(files > 0){
+      // `slip a.slip b.slip` runs the files in order instead of the REPL
+      for(int i = 1; i <= files; i++){
+        lval* x = lload(global, argv[i], 1);
+        if(lval_type(x) == LVAL_ERR){
+          lval_println(x);
+          status = 1;
+        }
+        lval_del(x);
+      }
+    }else if(batch){
+      slip_batch(global, use_mpc ? Slip : NULL);
+    }else{
+      puts("Slip version 0.0.0.0");
+      puts("Press ctrl+c to exit");
+
+      // REPL(oop)
+      char* input;
+      while((input = readline("slip> ")) != NULL){
+        add_history(input);
+        slip_line(global, input, strlen(input), use_mpc ? Slip : NULL);
         free(input);
+      }
     }
 
+    lval_print_flush();
     lenv_del(global);
     mpc_cleanup(7, Number, Bool, Symbol, SExpr, QExpr, Expr, Slip);
 
-    return 0;
+    return status;
 }